@@ -94,6 +94,9 @@
 */
 #include "wiced_hal_mia.h"
 #include "wiced_memory.h"
+#ifdef SUPPORT_SCROLL
+ #include "wiced_hal_quadrature.h"
+#endif
 #include "gki_target.h"
 #include "app.h"
 
@@ -190,58 +193,15 @@ STATIC uint8_t APP_getProtocol(void)
  *******************************************************************************/
 STATIC uint8_t APP_getReport( uint8_t reportType, uint8_t reportId)
 {
-    uint8_t size;
-    void *reportPtr = 0;
-
-    // We only handle input/output reports.
-    if (reportType == HID_PAR_REP_TYPE_INPUT)
-    {
-        switch (reportId) {
-        case RPT_ID_IN_STD_KEY:
-            size = sizeof(KeyboardStandardReport);
-            reportPtr = &key_rpts.stdRpt;
-            break;
-
-        case RPT_ID_IN_BIT_MAPPED:
-            size = sizeof(KeyboardBitMappedReport);
-            reportPtr = &key_rpts.bitMappedReport;
-            break;
-
-        case RPT_ID_IN_BATTERY:
-            size = sizeof(BatteryReport);
-            reportPtr = &batRpt;
-            break;
-
-        case RPT_ID_IN_SLEEP:
-            size = sizeof(KeyboardSleepReport);
-            reportPtr = &key_rpts.sleepReport;
-            break;
-
-        case RPT_ID_IN_FUNC_LOCK:
-            size = sizeof(KeyboardFuncLockReport);
-            reportPtr = &key_rpts.funcLockReport;
-            break;
-
-        }
-    }
-    else if (reportType == HID_PAR_REP_TYPE_OUTPUT)
-    {
-        // Ensure that one of the valid keyboard output reports is being requested
-        // Also grab its length and pointer
-        if (reportId == RPT_ID_OUT_KB_LED)
-        {
-            size = sizeof(KeyboardLedReport);
-            reportPtr = &key_rpts.ledReport;
-        }
-    }
+    const report_entry_t * rpt = report_find(reportType, reportId);
 
     // We do not understand this, pass this to the base class.
-    if (!reportPtr)
+    if (!rpt || !rpt->data)
     {
         return HID_PAR_HANDSHAKE_RSP_ERR_INVALID_PARAM;
     }
 
-    hidd_link_send_data(HCI_CONTROL_HID_REPORT_CHANNEL_CONTROL, reportType , reportPtr, size);
+    hidd_link_send_data(HCI_CONTROL_HID_REPORT_CHANNEL_CONTROL, reportType , rpt->data, rpt->size);
 
     // Done!
     return HID_PAR_HANDSHAKE_RSP_SUCCESS;
@@ -482,6 +442,9 @@ STATIC void APP_shutdown(void)
 {
     WICED_BT_TRACE("\napp_shutdown");
 
+    key_statsSave();
+    ble_statsSave();
+
     // Flush the event queue
     wiced_hidd_event_queue_flush(&app.eventQueue);
 
@@ -527,6 +490,11 @@ static uint8_t APP_pollActivityUser(void)
     // Poll and queue key activity
     kscan_pollActivity();
 
+#ifdef SUPPORT_SCROLL
+    // integrate the encoder movement since the last poll
+    key_scrollMotion(wiced_hal_quadrature_get_scroll_count());
+#endif
+
 #ifdef SUPPORT_CODE_ENTRY
     // Check if we are in pin code entry mode. If so, call the pin code entry processing function
     if (!key_entry_idle())
@@ -540,7 +508,7 @@ static uint8_t APP_pollActivityUser(void)
 #endif
     {
         // For all other cases, return value indicating whether any event is pending or
-        status = wiced_hidd_event_queue_get_num_elements(&app.eventQueue) || kscan_is_any_key_pressed() ? HIDLINK_ACTIVITY_REPORTABLE : HIDLINK_ACTIVITY_NONE;
+        status = wiced_hidd_event_queue_get_num_elements(&app.eventQueue) || kscan_is_any_key_pressed() || key_scrollPending() || macro_playing() ? HIDLINK_ACTIVITY_REPORTABLE : HIDLINK_ACTIVITY_NONE;
 
 #if (SLEEP_ALLOWED == 3)
         if (!app.pollStarted)
@@ -573,7 +541,7 @@ static uint8_t APP_pollActivityUser(void)
  * Return:
  *   WICED_SLEEP_NOT_ALLOWED -- not allow to sleep
  *   When WICED_SLEEP_POLL_TIME_TO_SLEEP:
- *      WICED_SLEEP_MAX_TIME_TO_SLEEP or the time to sleep
+ *      WICED_SLEEP_MAX_TIME_TO_SLEEP or the time in us to the earliest sleep deadline
  *   When WICED_SLEEP_POLL_SLEEP_PERMISSION:
  *      WICED_SLEEP_ALLOWED_WITH_SHUTDOWN -- allowed to sleep, but no SDS nor ePDS
  *      WICED_SLEEP_ALLOWED_WITHOUT_SHUTDOWN -- allowed to enter SDS/ePDS
@@ -582,6 +550,7 @@ static uint8_t APP_pollActivityUser(void)
 uint32_t APP_sleep_handler(wiced_sleep_poll_type_t type )
 {
     uint32_t ret = WICED_SLEEP_NOT_ALLOWED;
+    uint32_t next_ms;
 
 #if SLEEP_ALLOWED
     switch(type)
@@ -589,17 +558,28 @@ uint32_t APP_sleep_handler(wiced_sleep_poll_type_t type )
         case WICED_SLEEP_POLL_TIME_TO_SLEEP:
             if (!(app.recoveryInProgress || keyscanActive()))
             {
-                ret = WICED_SLEEP_MAX_TIME_TO_SLEEP;
+                // sleep until the earliest deadline posted by any module
+                next_ms = sleep_time_to_next_deadline();
+                ret = (next_ms >= WICED_SLEEP_MAX_TIME_TO_SLEEP / 1000) ? WICED_SLEEP_MAX_TIME_TO_SLEEP : next_ms * 1000;
             }
             break;
 
         case WICED_SLEEP_POLL_SLEEP_PERMISSION:
  #if SLEEP_ALLOWED > 1
             ret = WICED_SLEEP_ALLOWED_WITH_SHUTDOWN;
-            // a key is down, no deep sleep
-            if (keyscanActive())
+            // a key is down or we are about to wake up soon anyway, no deep sleep
+            if (keyscanActive() || !sleep_shutdown_allowed())
  #endif
             ret = WICED_SLEEP_ALLOWED_WITHOUT_SHUTDOWN;
+
+            // the key counters and reconnect statistics are lost with the RAM. Stay
+            // out of deep sleep until the application thread has saved them, both
+            // checks run so each save is queued
+            if ((ret == WICED_SLEEP_ALLOWED_WITH_SHUTDOWN) &&
+                (!key_statsReadyForSleep() | !ble_statsReadyForSleep()))
+            {
+                ret = WICED_SLEEP_ALLOWED_WITHOUT_SHUTDOWN;
+            }
             break;
     }
 #endif
@@ -680,7 +660,7 @@ STATIC void APP_procErrKeyscan(void)
  *   None
  *
  *******************************************************************************/
-STATIC void APP_generateAndTxReports(void)
+APP_HOT STATIC void APP_generateAndTxReports(void)
 {
     app_queue_t *curEvent;
 
@@ -695,8 +675,15 @@ STATIC void APP_generateAndTxReports(void)
             key_send();
         }
     }
-    // Continue report generation as long as the transport has room and we have events to process
-    while ((wiced_bt_buffer_poolutilization (HCI_ACL_POOL_ID) < 80) &&
+    else
+    {
+        // reports that found no room last time go before any new event
+        key_send();
+    }
+
+    // Continue report generation as long as the transport has room, the earlier reports are out,
+    // and we have events to process
+    while (route_txReady() && !key_sendPending() &&
            ((curEvent = (app_queue_t *)wiced_hidd_event_queue_get_current_element(&app.eventQueue)) != NULL))
     {
         // Further processing depends on the event type
@@ -741,13 +728,14 @@ STATIC void APP_generateAndTxReports(void)
  *  none
  *
  * Parameters:
- *  newState new state of the link
+ *  connEvt -- TRUE for the poll the transport runs at a connection event,
+ *             FALSE for a poll run from the keyscan interrupt or at start up
  *
  * Return:
  *  None
  *
  *******************************************************************************/
-STATIC void APP_pollReportUserActivity(void)
+APP_HOT STATIC void APP_pollReportUserActivity(wiced_bool_t connEvt)
 {
     uint8_t activitiesDetectedInLastPoll;
 
@@ -762,23 +750,54 @@ STATIC void APP_pollReportUserActivity(void)
     // Check for activity. This should queue events if any user activity is detected
     activitiesDetectedInLastPoll = APP_pollActivityUser();
 
-    // Check if the active transport is connected
-    if(hidd_link_is_connected())
+    if (activitiesDetectedInLastPoll != HIDLINK_ACTIVITY_NONE)
+    {
+        app.activityBtClk = wiced_hidd_get_current_native_bt_clocks();
+    }
+
+    // typing keeps the BR/EDR link at short sniff latency
+    if (activitiesDetectedInLastPoll & HIDLINK_ACTIVITY_REPORTABLE)
     {
+        bredr_pmActivity();
+    }
+
+    // LE slave latency comes back once the keys are quiet
+    ble_pollActivity(activitiesDetectedInLastPoll);
+
+    // Check if the transport the reports go to is connected
+    if(route_isConnected())
+    {
+        // the polls run between connection events do not add to the radio load
+        if (connEvt)
+        {
+            bat_load_event(BAT_LOAD_CONN_EVT);
+        }
+
         // Generate a report
         if(!bt_cfg.security_requirement_mask || hidd_link_is_encrypted())
         {
 
             APP_generateAndTxReports();
-        }
 
-#ifdef BATTERY_REPORT_SUPPORT
-        if (!ota_is_active())
-        {
-            // poll for battery monitor
-            wiced_hal_batmon_poll_monitor();
+            // keys held back for a combo go on once the combo window has passed
+            key_comboPoll();
+
+            // a dual role key held past its tapping term turns into its modifier
+            key_tapHoldPoll();
+
+            // next macro event, paced by the connection events
+            macro_poll();
+
+            // one scroll report per connection event at most, the keyscan polls
+            // in between only accumulate the movement
+            if (connEvt)
+            {
+                key_scrollSend();
+            }
         }
-#endif
+
+        // send battery level if changed
+        bat_poll();
     }
     else
     {
@@ -789,6 +808,74 @@ STATIC void APP_pollReportUserActivity(void)
             hidd_link_connect();
         }
     }
+
+    // settle the journal once the keyboard has been quiet for a while. The page write
+    // blocks the CPU, so it is kept away from polls that may have keys to report
+    if (activitiesDetectedInLastPoll == HIDLINK_ACTIVITY_NONE && !ota_is_active()
+        && (BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(app.activityBtClk)) >= APP_JOURNAL_COMPACT_IDLE_MS))
+    {
+        journal_compact();
+    }
+}
+
+/********************************************************************************
+ * Function Name: APP_connEvtPoll
+ ********************************************************************************
+ * Summary:
+ *  Poll callback of the transport, run at each connection event
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+APP_HOT STATIC void APP_connEvtPoll(void)
+{
+    APP_pollReportUserActivity(TRUE);
+}
+
+/********************************************************************************
+ * Function Name: APP_keyscanActivity
+ ********************************************************************************
+ * Summary:
+ *  Keyscan interrupt. On LE the keys are read by the poll at the next connection
+ *  event, so the report is built just ahead of the event that sends it. Otherwise
+ *  poll right away.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void APP_keyscanActivity(void)
+{
+    if (!ble_keyscanActivity())
+    {
+        APP_pollReportUserActivity(FALSE);
+    }
+}
+
+/********************************************************************************
+ * Function Name: APP_clearSentReports
+ ********************************************************************************
+ * Summary:
+ *   Forget the reports sent so far, so the next report of each kind goes out
+ *   even if it repeats the last one. Used when the host may have lost them.
+ *
+ * Parameters:
+ *   none
+ *
+ * Return:
+ *   None
+ *
+ *******************************************************************************/
+STATIC void APP_clearSentReports(void)
+{
+    route_forgetSent();
 }
 
 /********************************************************************************
@@ -816,13 +903,14 @@ uint8_t APP_setProtocol(uint8_t newProtocol)
     // Check if the protocol was changed and the new protocol is report
     if ((app.protocol != newProtocol) && (newProtocol == HID_PAR_PROTOCOL_REPORT))
     {
-        key_clear(FALSE);
-
         // clear sleep bits
         key_rpts.sleepReport.sleepVal = 0;
         // Mark the func-lock key as up.
         key_rpts.funcLockReport.status = FUNC_LOCK_KEY_UP;
 
+        key_clear(FALSE);
+        APP_clearSentReports();
+
         app.protocol = newProtocol;
     }
 
@@ -930,20 +1018,78 @@ void app_setReport(wiced_hidd_report_type_t reportType,
                      void *payload,
                      uint16_t payloadSize)
 {
+    const report_entry_t * rpt = report_find(reportType, reportId);
+
     WICED_BT_TRACE("\napp_setReport: %d", payloadSize);
     app.setReport_status = HID_PAR_HANDSHAKE_RSP_SUCCESS;
 
-    if (!key_setReport(reportType, reportId, payload, payloadSize))
+    if (rpt && rpt->set)
     {
-        if ((reportType == WICED_HID_REPORT_TYPE_FEATURE) && (reportId == RPT_ID_IN_CNT_CTL))
-        {
-            app.connection_ctrl_rpt = *((uint8_t*)payload);
-            WICED_BT_TRACE("\nPTS_HIDS_CONFORMANCE_TC_CW_BV_03_C write val: %d ", app.connection_ctrl_rpt);
-        }
-        else
-        {
-            app.setReport_status = HID_PAR_HANDSHAKE_RSP_ERR_UNSUPPORTED_REQ;
-        }
+        rpt->set(reportType, reportId, payload, payloadSize);
+    }
+    else
+    {
+        app.setReport_status = HID_PAR_HANDSHAKE_RSP_ERR_UNSUPPORTED_REQ;
+    }
+}
+
+/********************************************************************************
+ * Function Name: app_setConnectionCtrl
+ ********************************************************************************
+ * Summary:
+ *   Handle the connection control feature report write
+ *
+ * Parameters:
+ *   reportType -- WICED_HID_REPORT_TYPE_FEATURE
+ *   reportId -- RPT_ID_FEATURE_CNT_CTL
+ *   payload -- new value
+ *   payloadSize -- payload length
+ *
+ * Return:
+ *   None
+ *
+ *******************************************************************************/
+void app_setConnectionCtrl(wiced_hidd_report_type_t reportType,
+                     uint8_t reportId,
+                     void *payload,
+                     uint16_t payloadSize)
+{
+    if (payloadSize)
+    {
+        app.connection_ctrl_rpt = *((uint8_t*)payload);
+        WICED_BT_TRACE("\nPTS_HIDS_CONFORMANCE_TC_CW_BV_03_C write val: %d ", app.connection_ctrl_rpt);
+    }
+}
+
+/********************************************************************************
+ * Function Name: app_sendReport
+ ********************************************************************************
+ * Summary:
+ *   Send an input report to the connected host
+ *
+ * Parameters:
+ *   ptr -- pointer to the report, starting with the report ID
+ *   len -- report length
+ *
+ * Return:
+ *   None
+ *
+ *******************************************************************************/
+void app_sendReport(void * ptr, uint16_t len)
+{
+    uint8_t idx = report_index(WICED_HID_REPORT_TYPE_INPUT, *(uint8_t *)ptr);
+
+    // a press and release within one scan, or a modifier toggled back, nets no change.
+    // scroll carries relative motion, so a repeat is new motion
+    if ((idx != RPT_IDX_SCROLL) && route_isRepeat(ptr, len))
+    {
+        app.suppressedRpts++;
+        return;
+    }
+
+    if (route_sendReport(ptr, len))
+    {
+        bat_load_event(BAT_LOAD_TX);
     }
 }
 
@@ -965,6 +1111,36 @@ void app_queueEvent(app_queue_t * event)
     wiced_hidd_event_queue_add_event_with_overflow(&app.eventQueue, &event->info, APP_QUEUE_SIZE, app.pollSeqn);
 }
 
+/********************************************************************************
+ * Function Name: app_crc32Update
+ ********************************************************************************
+ * Summary:
+ *   Update CRC32 (IEEE 802.3) with new data
+ *
+ * Parameters:
+ *   crc -- current crc
+ *   buf -- data
+ *   len -- data length
+ *
+ * Return:
+ *   updated crc
+ *
+ *******************************************************************************/
+uint32_t app_crc32Update(uint32_t crc, const uint8_t * buf, uint16_t len)
+{
+    uint8_t bit;
+
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
 /********************************************************************************
  * Function Name: app_transportStateChangeNotification
  ********************************************************************************
@@ -983,13 +1159,22 @@ void app_transportStateChangeNotification(uint8_t transport, uint8_t newState)
     int16_t flags;
 //    WICED_BT_TRACE("\n%s %s (%d)", transport==BT_TRANSPORT_LE ? "LE":"BR/EDR", hidd_link_state_str(newState), newState & HIDLINK_MASK);
     uint8_t led = transport==BT_TRANSPORT_LE ? LED_LE_LINK : LED_BREDR_LINK;
+    uint8_t ledDeadline = transport==BT_TRANSPORT_LE ? SLEEP_DEADLINE_LED_LE : SLEEP_DEADLINE_LED_BREDR;
+
+    route_linkStateChange(transport, newState);
 
     hidd_led_blink_stop(led);
+    bat_led_state(led, 0);
+    sleep_clear_deadline(ledDeadline);
     hidd_set_deep_sleep_allowed(WICED_FALSE);
 
     switch (newState & HIDLINK_MASK) {
     case HIDLINK_CONNECTED:
         hidd_led_on(led);
+        bat_led_state(led, 100);
+
+        // let the new host know the battery level
+        bat_connected();
 
         // enable ghost detection
         kscan_enable_ghost_detection(TRUE);
@@ -1001,35 +1186,48 @@ void app_transportStateChangeNotification(uint8_t transport, uint8_t newState)
             //We connected after power on reset or HID off recovery.
             //Start 20 second timer to allow time to setup connection encryption
             //before allowing HID Off/Micro-BCS.
-            hidd_deep_sleep_not_allowed(20000); //20 seconds. timeout in ms
+            sleep_deep_sleep_not_allowed(20000); //20 seconds. timeout in ms
         }
         else
         {
             //Wake up from HID Off and already have a connection then allow HID Off in 1 second
             //This will allow time to send a key press.
             //To do need to check if key event is in the queue at lpm query
-            hidd_deep_sleep_not_allowed(1000); // 1 second. timeout in ms
+            sleep_deep_sleep_not_allowed(1000); // 1 second. timeout in ms
         }
         break;
 
     case HIDLINK_DISCONNECTED:
         hidd_led_off(led);
         hidd_led_off(LED_CAPS);
+        bat_led_state(LED_CAPS, 0);
 
         // disable Ghost detection
         kscan_enable_ghost_detection(FALSE);
 
+        key_statsSave();
+        ble_statsSave();
+        WICED_BT_TRACE("\n%d repeated reports not sent", app.suppressedRpts);
+
         // Tell the transport to stop polling
         hidd_link_enable_poll_callback(transport,WICED_FALSE);
-        hidd_deep_sleep_not_allowed(2000); //2 seconds. timeout in ms
+        sleep_deep_sleep_not_allowed(2000); //2 seconds. timeout in ms
         break;
 
     case HIDLINK_DISCOVERABLE:
         hidd_led_blink(led, 0, 500);
+ #if LED_SUPPORT
+        bat_led_state(led, 50);
+        sleep_post_periodic_deadline(ledDeadline, 500);
+ #endif
         break;
 
     case HIDLINK_RECONNECTING:
         hidd_led_blink(led, 0, 200);     // faster blink LINK line to indicate reconnecting
+ #if LED_SUPPORT
+        bat_led_state(led, 50);
+        sleep_post_periodic_deadline(ledDeadline, 200);
+ #endif
         break;
 
     case HIDLINK_ADVERTISING_IN_uBCS_DIRECTED:
@@ -1060,7 +1258,7 @@ wiced_sleep_config_t    hidd_link_sleep_config = {
  *******************************************************************************/
 hidd_link_callback_t appCallbacks =
 {
-    .p_app_poll_user_activities                 = APP_pollReportUserActivity,       //   *p_app_poll_user_activities;
+    .p_app_poll_user_activities                 = APP_connEvtPoll,                  //   *p_app_poll_user_activities;
     .p_app_connection_failed_notification       = APP_connectFailedNotification,    //   *p_app_connection_failed_notification;
 
 #ifdef SUPPORT_CODE_ENTRY
@@ -1110,13 +1308,22 @@ wiced_result_t app_start(void)
     /* component/peripheral init */
     bat_init(APP_shutdown);
     hidd_link_init();
-    key_init(NUM_KEYSCAN_ROWS, NUM_KEYSCAN_COLS, APP_pollReportUserActivity, APP_keyDetected);
+    journal_init();
+    ota_init();
+    key_statsInit();
+    key_configInit();
+    keymap_init();
+    key_init(NUM_KEYSCAN_ROWS, NUM_KEYSCAN_COLS, APP_keyscanActivity, APP_keyDetected);
+#ifdef SUPPORT_SCROLL
+    wiced_hal_quadrature_init();
+#endif
 
     wiced_hal_mia_enable_mia_interrupt(TRUE);
     wiced_hal_mia_enable_lhl_interrupt(TRUE);//GPIO interrupt
 
     // poll for any activities
-    APP_pollReportUserActivity();
+    app.activityBtClk = wiced_hidd_get_current_native_bt_clocks();
+    APP_pollReportUserActivity(FALSE);
 
     WICED_BT_TRACE("\nFree RAM bytes=%d bytes", wiced_memory_get_free_bytes());
 
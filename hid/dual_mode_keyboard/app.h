@@ -54,6 +54,14 @@
  #define STATIC static
 #endif
 
+// Key scan to report path. In XIP build, this code is placed in RAM so a poll wakeup does not
+// run it through flash cache misses.
+#ifdef HOT_PATH_IN_RAM
+ #define APP_HOT __attribute__((section(".text_in_ram")))
+#else
+ #define APP_HOT
+#endif
+
 /********************************************************************************
 * Types and Defines
 *******************************************************************************/
@@ -102,8 +110,23 @@
  #define CONNECT_KEY_INDEX   8
 #endif
 
+// one BT clock is 312.5 us
+#define BT_CLOCKS_TO_MS(c)          (((c) * 5) / 16)
+#define MS_TO_BT_CLOCKS(ms)         (((ms) * 16) / 5)
+
 typedef void (app_poll_callback_t)(void);
 
+/********************************************************************************
+ * NVRAM VS IDs used by the application. The ones right after
+ * WICED_NVRAM_VSID_START are used by the HID device library.
+ ********************************************************************************/
+typedef enum {
+    VS_ID_OTA_RESUME    = WICED_NVRAM_VSID_START + 0x20,
+    VS_ID_MACRO         = WICED_NVRAM_VSID_START + 0x21,   // MACRO_SLOTS records
+    VS_ID_KEYMAP        = WICED_NVRAM_VSID_START + 0x24,   // 2 records
+    VS_ID_JOURNAL       = WICED_NVRAM_VSID_START + 0x26,   // JOURNAL_PAGES records
+} app_vs_id_e;
+
 /********************************************************************************
  * Report ID defines
  ********************************************************************************/
@@ -116,6 +139,7 @@ typedef enum {
     RPT_ID_IN_FUNC_LOCK  =0x05,
     RPT_ID_IN_SCROLL     =0x06,
     RPT_ID_IN_PIN        =0x07,
+    RPT_ID_IN_CONSUMER   =0x08,
     RPT_ID_IN_CNT_CTL    =0xcc,
     RPT_ID_NOT_USED      =0xff,
 } rpt_id_in_e;
@@ -128,6 +152,7 @@ typedef enum {
 // Feature report id
 typedef enum {
     RPT_ID_FEATURE_CNT_CTL   =0xcc,
+    RPT_ID_FEATURE_KEY_STATS =0xcd,
 } rpt_id_feature_e;
 
 // BIT mapped defines
@@ -152,6 +177,23 @@ enum
     BIT_MAPPED_MAX
 };
 
+// Consumer control keys. The 16-bit usage of each is in key_ccUsage[]
+enum
+{
+    CC_MUTE,                    // 0    CC_USAGE_MUTE
+    CC_VOL_UP,                  // 1    CC_USAGE_VOL_UP
+    CC_VOL_DOWN,                // 2    CC_USAGE_VOL_DOWN
+    CC_PLAY_PAUSE,              // 3    CC_USAGE_PLAY_PAUSE
+    CC_NEXT_TRACK,              // 4    CC_USAGE_NEXT_TRACK
+    CC_PREV_TRACK,              // 5    CC_USAGE_PREV_TRACK
+    CC_FAST_FORWARD,            // 6    CC_USAGE_FAST_FORWRD
+    CC_REWIND,                  // 7    CC_USAGE_REWIND
+    CC_AC_SEARCH,               // 8    CC_USAGE_AC_SEARCH
+    CC_AC_HOME,                 // 9    CC_USAGE_AC_HOME
+    CC_AC_BACK,                 // 10   CC_USAGE_AC_BACK
+    CC_MAX
+};
+
 /********************************************************************************
  * App queue defines
  ********************************************************************************/
@@ -171,11 +213,19 @@ typedef union {
 /********************************************************************************
  * Include all components
  *******************************************************************************/
+#include "sleep/sleep.h"
+#include "journal/journal.h"
 #include "battery/battery.h"
 #include "ota/ota.h"
+#include "macro/macro.h"
+#include "keymap/keymap.h"
 #include "bt/bt.h"
 #include "key/key.h"
 #include "key/key_entry.h"
+#include "key/key_stats.h"
+#include "report/report.h"
+
+#define APP_JOURNAL_COMPACT_IDLE_MS 10000       // quiet time before the journal is compacted
 
 typedef struct {
     wiced_hidd_app_event_queue_t eventQueue;
@@ -187,6 +237,8 @@ typedef struct {
     uint8_t connection_ctrl_rpt;
     uint8_t  idleRate;                           // Save the idle rate in units of 4 ms
     uint32_t idleRateInBtClocks;                 // Convert to BT clocks for later use. Formula is ((Rate in 4 ms)*192)/15
+    uint32_t suppressedRpts;                     // reports not sent as they repeat the last one
+    uint32_t activityBtClk;                      // BT clock of the last user activity
 
     uint8_t transportStateChangeNotification:1;
     uint8_t pollStarted:1;
@@ -218,6 +270,43 @@ void app_setReport(wiced_hidd_report_type_t reportType,
                      void *payload,
                      uint16_t payloadSize);
 
+/********************************************************************************
+ * Function Name: app_setConnectionCtrl
+ ********************************************************************************
+ * Summary:
+ *  Handle the connection control feature report write
+ *
+ * Parameters:
+ *  reportType -- WICED_HID_REPORT_TYPE_FEATURE
+ *  reportId -- RPT_ID_FEATURE_CNT_CTL
+ *  payload -- new value
+ *  payloadSize -- payload length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void app_setConnectionCtrl(wiced_hidd_report_type_t reportType,
+                     uint8_t reportId,
+                     void *payload,
+                     uint16_t payloadSize);
+
+/********************************************************************************
+ * Function Name: app_sendReport
+ ********************************************************************************
+ * Summary:
+ *  Send an input report to the connected host
+ *
+ * Parameters:
+ *  ptr -- pointer to the report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void app_sendReport(void * ptr, uint16_t len);
+
 /********************************************************************************
  * Function Name: app_queueEvent
  ********************************************************************************
@@ -233,6 +322,24 @@ void app_setReport(wiced_hidd_report_type_t reportType,
  *******************************************************************************/
 void app_queueEvent(app_queue_t * event);
 
+/********************************************************************************
+ * Function Name: app_crc32Update
+ ********************************************************************************
+ * Summary:
+ *  Update CRC32 (IEEE 802.3) with new data. Start with 0xffffffff and invert
+ *  the result when done.
+ *
+ * Parameters:
+ *  crc -- current crc
+ *  buf -- data
+ *  len -- data length
+ *
+ * Return:
+ *  updated crc
+ *
+ *******************************************************************************/
+uint32_t app_crc32Update(uint32_t crc, const uint8_t * buf, uint16_t len);
+
 /********************************************************************************
  * Function Name: app_transportStateChangeNotification
  ********************************************************************************
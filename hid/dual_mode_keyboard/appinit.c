@@ -71,7 +71,7 @@ void application_start( void )
     wiced_set_debug_uart(WICED_ROUTE_DEBUG_TO_PUART);
     hidd_led_init(led_count, platform_led);
 
-    hidd_start(app_start, NULL, &bt_cfg, wiced_bt_hid_cfg_buf_pools);
+    hidd_start(app_start, ble_management_cback, &bt_cfg, wiced_bt_hid_cfg_buf_pools);
 
     WICED_BT_TRACE("\nDEV=%d Version:%d.%d Rev=%d Build=%d",hidd_chip_id(), WICED_SDK_MAJOR_VER, WICED_SDK_MINOR_VER, WICED_SDK_REV_NUMBER, WICED_SDK_BUILD_NUMBER);
 
@@ -82,9 +82,9 @@ void application_start( void )
     WICED_BT_TRACE("\nSLEEP_ALLOWED=%d",SLEEP_ALLOWED);
     WICED_BT_TRACE("\nLED SUPPORT=%d", LED_SUPPORT);
 
-#ifdef OTA_FIRMWARE_UPGRADE
+#ifdef APP_OTA_FW_UPGRADE
     WICED_BT_TRACE("\nOTA_FW_UPGRADE");
- #ifdef OTA_SECURE_FIRMWARE_UPGRADE
+ #ifdef APP_OTA_SEC_FW_UPGRADE
     WICED_BT_TRACE("\nOTA_SEC_FW_UPGRADE");
  #endif
 #endif
@@ -101,6 +101,30 @@ void application_start( void )
     WICED_BT_TRACE("\nAUTO_RECONNECT");
 #endif
 
+#ifdef SUPPORT_SCROLL
+    WICED_BT_TRACE("\nSCROLL");
+#endif
+
+#ifdef SUPPORT_MACRO
+    WICED_BT_TRACE("\nMACRO");
+#endif
+
+#ifdef SUPPORT_KEYMAP
+    WICED_BT_TRACE("\nKEYMAP");
+#endif
+
+#ifdef SUPPORT_KEY_STATS
+    WICED_BT_TRACE("\nKEY_STATS");
+#endif
+
+#ifdef SUPPORT_DUAL_HOST
+    WICED_BT_TRACE("\nDUAL_HOST");
+#endif
+
+#ifdef SUPPORT_BREDR_SNIFF
+    WICED_BT_TRACE("\nBREDR_SNIFF");
+#endif
+
 #ifdef ENDLESS_LE_ADVERTISING_WHILE_DISCONNECTED
     WICED_BT_TRACE("\nDISCONNECTED_ENDLESS_ADV");
 #endif
@@ -108,4 +132,12 @@ void application_start( void )
 #ifdef LE_LOCAL_PRIVACY_SUPPORT
     WICED_BT_TRACE("\nLE_LOCAL_PRIVACY_SUPPORT");
 #endif
+
+#ifdef CONN_EVT_ALIGN
+    WICED_BT_TRACE("\nCONN_EVT_ALIGN");
+#endif
+
+#ifdef HOT_PATH_IN_RAM
+    WICED_BT_TRACE("\nHOT_PATH_IN_RAM");
+#endif
 }
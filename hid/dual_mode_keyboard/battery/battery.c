@@ -35,12 +35,218 @@
  *
  * This file defines the interface of battery report service
  *
+ * The battery voltage is sampled with an adaptive period. While the voltage is
+ * stable and far from the drained level, it is sampled sparsely. When it is
+ * moving or getting close to the drained/shutdown thresholds, it is sampled
+ * densely. Samples go through a first order IIR filter and the reported level
+ * only changes when the filtered level moved by more than the hysteresis.
+ *
+ * Each sample is compensated for the voltage sag caused by the load seen since
+ * the previous sample (report TX, connection events and LED on time). The same
+ * load estimate drives the remaining runtime estimate.
+ *
  */
 
 #ifdef BATTERY_REPORT_SUPPORT
+#include "wiced_memory.h"
+#include "gki_target.h"
 #include "app.h"
 
+#define BAT_FULL_MV                 3200    // The full battery voltage in mili-volts
+#define BAT_DRAINED_MV              1800    // The voltage at which the batteries are considered drained (in milli-volts)
+#define BAT_SHUTDOWN_MV             1700    // System should shutdown if it detects battery voltage at or below this value (in milli-volts)
+#define BAT_LEVEL_MAX               100     // battery report max level
+
+#define BAT_SAMPLE_SPARSE_MS        60000   // sampling period when the voltage is stable
+#define BAT_SAMPLE_DENSE_MS         3000    // sampling period near the thresholds or when the voltage moves
+#define BAT_SAMPLE_DEFER_MS         50      // first retry delay when the radio is busy, doubled on each retry
+#define BAT_SAMPLE_DEFER_MAX        3       // retries before the sample is skipped
+#define BAT_DENSE_MARGIN_MV         150     // sample densely below BAT_DRAINED_MV + margin
+#define BAT_STABLE_MV               10      // deviation from the filtered value considered as stable
+#define BAT_INIT_SAMPLES            8       // samples averaged for the initial filter value
+
+#define BAT_FILTER_FRAC             4       // filter fixed point fraction bits
+#define BAT_FILTER_SHIFT            2       // IIR coefficient 1/4
+#define BAT_LEVEL_HYSTERESIS        2       // level must move this much before it is reported
+
+// Load model. The cell voltage sags by the average load current times the cell internal
+// resistance. The load current is estimated from the activity seen since the previous sample.
+#define BAT_CAPACITY_MAH            1000    // 2 x AAA alkaline in series
+#define BAT_INTERNAL_RES_OHM        20      // cell internal resistance, both cells
+#define BAT_BASE_UA                 30      // average current when idle
+#define BAT_TX_CHARGE_NC            6000    // charge used by one report TX, 6 mA for 1 ms
+#define BAT_CONN_EVT_CHARGE_NC      2500    // charge used by one connection event
+#define BAT_LED_UA                  2000    // current of one LED when on
+#define BAT_SAG_MAX_MV              200     // upper limit of the load compensation
+#define BAT_CURRENT_FILTER_SHIFT    3       // IIR coefficient 1/8 for the long term current
+#define BAT_LED_MAX                 4
+
+typedef struct {
+    wiced_timer_t sample_timer;
+    void (*shutdown_cb)();
+    int32_t filtered;                       // filtered voltage in mV, BAT_FILTER_FRAC fraction bits
+
+    // activity since the previous sample
+    uint32_t windowStartBtClk;
+    uint16_t loadCount[BAT_LOAD_MAX];
+    uint32_t ledOnTime_ms;
+    uint32_t ledStartBtClk[BAT_LED_MAX];
+    uint8_t  ledDuty[BAT_LED_MAX];          // 0 off, 100 on, in between when blinking
+    uint32_t avgCurrent_uA;                 // long term average current
+
+    uint8_t initialized:1;
+    uint8_t reportPending:1;
+    uint8_t shutdown:1;
+    uint8_t dense:1;                        // sampling at BAT_SAMPLE_DENSE_MS
+    uint8_t deferCount;                     // retries of the current sample
+} bat_data_t;
+
+static bat_data_t bat = {};
+
 BatteryReport batRpt={RPT_ID_IN_BATTERY,{100}};
+uint16_t batRuntimeHours = 0xffff;
+
+/********************************************************************************
+ * Function Name: Bat_readVoltage
+ ********************************************************************************
+ * Summary: read battery voltage from ADC
+ *
+ * Parameters:
+ *  count -- number of samples to average
+ *
+ * Return:
+ *  voltage in mV
+ *
+ *******************************************************************************/
+STATIC uint32_t Bat_readVoltage(uint8_t count)
+{
+    uint32_t sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        sum += wiced_hal_adc_read_voltage(ADC_INPUT_VDDIO);
+    }
+    return sum / count;
+}
+
+/********************************************************************************
+ * Function Name: Bat_voltageToLevel
+ ********************************************************************************
+ * Summary: convert voltage to battery level
+ *
+ * Parameters:
+ *  mv -- voltage in mV
+ *
+ * Return:
+ *  battery level, 0 to BAT_LEVEL_MAX
+ *
+ *******************************************************************************/
+STATIC uint8_t Bat_voltageToLevel(int32_t mv)
+{
+    if (mv <= BAT_DRAINED_MV)
+    {
+        return 0;
+    }
+    if (mv >= BAT_FULL_MV)
+    {
+        return BAT_LEVEL_MAX;
+    }
+    return ((mv - BAT_DRAINED_MV) * BAT_LEVEL_MAX) / (BAT_FULL_MV - BAT_DRAINED_MV);
+}
+
+/********************************************************************************
+ * Function Name: Bat_ledOnTime
+ ********************************************************************************
+ * Summary: accumulate the on time of the LED since its last state change
+ *
+ * Parameters:
+ *  led -- LED index
+ *
+ * Return:
+ *  None
+ *
+ *******************************************************************************/
+STATIC void Bat_ledOnTime(uint8_t led)
+{
+    if (bat.ledDuty[led])
+    {
+        bat.ledOnTime_ms += BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(bat.ledStartBtClk[led])) * bat.ledDuty[led] / 100;
+    }
+    bat.ledStartBtClk[led] = wiced_hidd_get_current_native_bt_clocks();
+}
+
+/********************************************************************************
+ * Function Name: Bat_loadCurrent
+ ********************************************************************************
+ * Summary: estimate the average load current since the previous sample and
+ *          restart the activity window
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  load current in uA
+ *
+ *******************************************************************************/
+STATIC uint32_t Bat_loadCurrent(void)
+{
+    uint32_t window_ms = BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(bat.windowStartBtClk));
+    uint32_t current_uA;
+    uint8_t led;
+
+    for (led = 0; led < BAT_LED_MAX; led++)
+    {
+        Bat_ledOnTime(led);
+    }
+
+    if (!window_ms)
+    {
+        window_ms = 1;
+    }
+
+    current_uA = BAT_BASE_UA
+               + (bat.loadCount[BAT_LOAD_TX] * BAT_TX_CHARGE_NC + bat.loadCount[BAT_LOAD_CONN_EVT] * BAT_CONN_EVT_CHARGE_NC) / window_ms
+               + (bat.ledOnTime_ms * BAT_LED_UA) / window_ms;
+
+    // restart the window
+    memset(bat.loadCount, 0, sizeof(bat.loadCount));
+    bat.ledOnTime_ms = 0;
+    bat.windowStartBtClk = wiced_hidd_get_current_native_bt_clocks();
+
+    return current_uA;
+}
+
+/********************************************************************************
+ * Function Name: Bat_updateRuntime
+ ********************************************************************************
+ * Summary: update the remaining runtime estimate from the battery level and
+ *          the long term average current
+ *
+ * Parameters:
+ *  current_uA -- load current of the last window
+ *
+ * Return:
+ *  None
+ *
+ *******************************************************************************/
+STATIC void Bat_updateRuntime(uint32_t current_uA)
+{
+    uint32_t hours;
+
+    if (!bat.avgCurrent_uA)
+    {
+        bat.avgCurrent_uA = current_uA;
+    }
+    else
+    {
+        bat.avgCurrent_uA = bat.avgCurrent_uA + ((int32_t)(current_uA - bat.avgCurrent_uA) >> BAT_CURRENT_FILTER_SHIFT);
+    }
+
+    // remaining capacity in uAh divided by the average current
+    hours = (batRpt.level[0] * BAT_CAPACITY_MAH * 10) / bat.avgCurrent_uA;
+    batRuntimeHours = hours > 0xfffe ? 0xfffe : hours;
+}
 
 /********************************************************************************
  * Function Name: Bat_batLevelChangeNotification
@@ -54,15 +260,214 @@ BatteryReport batRpt={RPT_ID_IN_BATTERY,{100}};
  *  None
  *
  *******************************************************************************/
-static void Bat_batLevelChangeNotification(uint32_t newLevel)
+STATIC void Bat_batLevelChangeNotification(uint8_t newLevel)
 {
-    // report only if the battery level is changed
-    if (batRpt.level[0] != newLevel)
+    int16_t delta = (int16_t) newLevel - batRpt.level[0];
+
+    // report only if the battery level moved beyond the hysteresis, but always report drained
+    if (delta && ((delta >= BAT_LEVEL_HYSTERESIS) || (delta <= -BAT_LEVEL_HYSTERESIS) || !newLevel))
     {
         WICED_BT_TRACE("\nbat level changed to %d", newLevel);
         batRpt.level[0] = newLevel;
-        hidd_link_send_report(&batRpt, sizeof(BatteryReport));
-        wiced_hal_batmon_set_battery_report_sent_flag(WICED_TRUE);
+        bat.reportPending = TRUE;
+        bat_poll();
+    }
+}
+
+/********************************************************************************
+ * Function Name: Bat_startSampleTimer
+ ********************************************************************************
+ * Summary: start the sample timer and post its sleep deadline
+ *
+ * Parameters:
+ *  timeout_ms -- time to the next sample
+ *
+ * Return:
+ *  None
+ *
+ *******************************************************************************/
+STATIC void Bat_startSampleTimer(uint32_t timeout_ms)
+{
+    wiced_start_timer(&bat.sample_timer, timeout_ms);
+    sleep_post_deadline(SLEEP_DEADLINE_BATTERY, timeout_ms);
+}
+
+/********************************************************************************
+ * Function Name: Bat_startSamplePeriod
+ ********************************************************************************
+ * Summary: schedule the next sample after the dense or sparse period
+ *
+ * Parameters:
+ *  dense -- TRUE for the dense period
+ *
+ * Return:
+ *  None
+ *
+ *******************************************************************************/
+STATIC void Bat_startSamplePeriod(wiced_bool_t dense)
+{
+    bat.dense = dense;
+    bat.deferCount = 0;
+    Bat_startSampleTimer(dense ? BAT_SAMPLE_DENSE_MS : BAT_SAMPLE_SPARSE_MS);
+}
+
+/********************************************************************************
+ * Function Name: Bat_sampleTimeout
+ ********************************************************************************
+ * Summary: take a battery sample, update the filtered level and schedule the
+ *          next sample based on how close the voltage is to the thresholds.
+ *
+ * Parameters:
+ *  arg -- not used
+ *
+ * Return:
+ *  None
+ *
+ *******************************************************************************/
+STATIC void Bat_sampleTimeout(uint32_t arg)
+{
+    int32_t mv, filtered_mv, deviation, sag_mv;
+    uint32_t current_uA;
+
+    // The supply sags while the radio transmits. An OTA keeps it busy for long, skip the sample.
+    if (ota_is_active())
+    {
+        Bat_startSamplePeriod(bat.dense || !bat.initialized);
+        return;
+    }
+
+    // retry a few times with a growing delay while reports are queued, then skip the sample.
+    // a short retry forbids deep sleep, it must not go on.
+    if (wiced_bt_buffer_poolutilization(HCI_ACL_POOL_ID))
+    {
+        if (bat.deferCount < BAT_SAMPLE_DEFER_MAX)
+        {
+            Bat_startSampleTimer(BAT_SAMPLE_DEFER_MS << bat.deferCount++);
+        }
+        else
+        {
+            Bat_startSamplePeriod(bat.dense || !bat.initialized);
+        }
+        return;
+    }
+
+    // compensate the reading for the sag caused by the recent load
+    current_uA = Bat_loadCurrent();
+    sag_mv = (current_uA * BAT_INTERNAL_RES_OHM) / 1000;
+    if (sag_mv > BAT_SAG_MAX_MV)
+    {
+        sag_mv = BAT_SAG_MAX_MV;
+    }
+
+    if (!bat.initialized)
+    {
+        mv = Bat_readVoltage(BAT_INIT_SAMPLES) + sag_mv;
+        bat.filtered = mv << BAT_FILTER_FRAC;
+        bat.initialized = TRUE;
+    }
+    else
+    {
+        mv = Bat_readVoltage(1) + sag_mv;
+        bat.filtered += ((mv << BAT_FILTER_FRAC) - bat.filtered) >> BAT_FILTER_SHIFT;
+    }
+
+    filtered_mv = bat.filtered >> BAT_FILTER_FRAC;
+    deviation = mv - filtered_mv;
+
+    if ((filtered_mv <= BAT_SHUTDOWN_MV) && !bat.shutdown)
+    {
+        WICED_BT_TRACE("\nbattery low %d mV, shutdown", filtered_mv);
+        bat.shutdown = TRUE;
+        if (bat.shutdown_cb)
+        {
+            bat.shutdown_cb();
+        }
+        return;
+    }
+
+    Bat_batLevelChangeNotification(Bat_voltageToLevel(filtered_mv));
+    Bat_updateRuntime(current_uA);
+
+    Bat_startSamplePeriod((filtered_mv < BAT_DRAINED_MV + BAT_DENSE_MARGIN_MV) || (deviation > BAT_STABLE_MV) || (deviation < -BAT_STABLE_MV));
+}
+
+/********************************************************************************
+ * Function Name: void bat_poll
+ ********************************************************************************
+ * Summary: send pending battery report if the link is ready
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_poll(void)
+{
+    if (bat.reportPending && route_isConnected() && !ota_is_active())
+    {
+        app_sendReport(&batRpt, sizeof(BatteryReport));
+        bat.reportPending = FALSE;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void bat_connected
+ ********************************************************************************
+ * Summary: link is connected, send the battery level to the new host
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_connected(void)
+{
+    bat.reportPending = TRUE;
+}
+
+/********************************************************************************
+ * Function Name: void bat_load_event
+ ********************************************************************************
+ * Summary: count a load event for the battery model
+ *
+ * Parameters:
+ *  type -- bat_load_e
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_load_event(uint8_t type)
+{
+    if ((type < BAT_LOAD_MAX) && (bat.loadCount[type] != 0xffff))
+    {
+        bat.loadCount[type]++;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void bat_led_state
+ ********************************************************************************
+ * Summary: record LED state change for the battery model
+ *
+ * Parameters:
+ *  led -- LED index
+ *  duty -- on duty cycle in percent. 0 is off, 100 is on
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_led_state(uint8_t led, uint8_t duty)
+{
+    if (LED_SUPPORT && (led < BAT_LED_MAX))
+    {
+        Bat_ledOnTime(led);
+        bat.ledDuty[led] = duty;
     }
 }
 
@@ -80,24 +485,15 @@ static void Bat_batLevelChangeNotification(uint32_t newLevel)
  *******************************************************************************/
 void bat_init(void (shutdown_cb)())
 {
-    //battery monitoring configuraion
-    wiced_hal_batmon_config(ADC_INPUT_VDDIO,      // ADC input pin
-                            3000,               // Period in millisecs between battery measurements
-                            8,                  // Number of measurements averaged for a report, max 16
-                            3200,               // The full battery voltage in mili-volts
-                            1800,               // The voltage at which the batteries are considered drained (in milli-volts)
-                            1700,               // System should shutdown if it detects battery voltage at or below this value (in milli-volts)
-                            100,                // battery report max level
-                            RPT_ID_IN_BATTERY,  // battery report ID
-                            1,                  // battery report length
-                            1);                 // Flag indicating that a battery report should be sent when a connection is established
-
-     //register App low battery shut down handler
-    wiced_hal_batmon_register_low_battery_shutdown_cb(shutdown_cb);
-    wiced_hal_batmon_add_battery_observer(Bat_batLevelChangeNotification);
-
-    //Setup Battery Service
-    wiced_hal_batmon_init();
+    //register App low battery shut down handler
+    bat.shutdown_cb = shutdown_cb;
+
+    wiced_hal_adc_init();
+    bat.windowStartBtClk = wiced_hidd_get_current_native_bt_clocks();
+    wiced_init_timer(&bat.sample_timer, Bat_sampleTimeout, 0, WICED_MILLI_SECONDS_TIMER);
+
+    // take the first sample now to have a valid level and catch a dead battery early
+    Bat_sampleTimeout(0);
 }
 
 #endif // BATTERY_REPORT_SUPPORT
@@ -42,7 +42,7 @@
 
 #ifdef BATTERY_REPORT_SUPPORT
 #include "wiced.h"
-#include "wiced_hal_batmon.h"
+#include "wiced_hal_adc.h"
 
 #define BATTERY_RPT_SIZE 1
 
@@ -55,7 +55,19 @@ typedef PACKED struct
     uint8_t    level[BATTERY_RPT_SIZE];
 }BatteryReport;
 
+/// Vendor specific remaining runtime characteristic in the battery service
+/// UUID: 8e5a0b10-6c31-4f2b-9d6e-2f1c3a7b4d01
+#define UUID_BATTERY_RUNTIME    0x01, 0x4d, 0x7b, 0x3a, 0x1c, 0x2f, 0x6e, 0x9d, 0x2b, 0x4f, 0x31, 0x6c, 0x10, 0x0b, 0x5a, 0x8e
+
+/// load events counted by the battery model
+typedef enum {
+    BAT_LOAD_TX,                // report sent
+    BAT_LOAD_CONN_EVT,          // connection event
+    BAT_LOAD_MAX
+} bat_load_e;
+
 extern BatteryReport batRpt;
+extern uint16_t batRuntimeHours;        // remaining runtime estimate in hours
 
 /********************************************************************************
  * Function Name: void bat_init
@@ -71,7 +83,68 @@ extern BatteryReport batRpt;
  *******************************************************************************/
 void bat_init(void (shutdown_cb)());
 
+/********************************************************************************
+ * Function Name: void bat_poll
+ ********************************************************************************
+ * Summary: send pending battery report if the link is ready
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_poll(void);
+
+/********************************************************************************
+ * Function Name: void bat_connected
+ ********************************************************************************
+ * Summary: link is connected, send the battery level to the new host
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_connected(void);
+
+/********************************************************************************
+ * Function Name: void bat_load_event
+ ********************************************************************************
+ * Summary: count a load event for the battery model
+ *
+ * Parameters:
+ *  type -- bat_load_e
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_load_event(uint8_t type);
+
+/********************************************************************************
+ * Function Name: void bat_led_state
+ ********************************************************************************
+ * Summary: record LED state change for the battery model
+ *
+ * Parameters:
+ *  led -- LED index
+ *  duty -- on duty cycle in percent. 0 is off, 100 is on
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bat_led_state(uint8_t led, uint8_t duty);
+
 #else
 # define bat_init(c)
+# define bat_poll()
+# define bat_connected()
+# define bat_load_event(t)
+# define bat_led_state(l,d)
 #endif
 #endif // __APP_BATTERY_H__
@@ -42,6 +42,7 @@
 #include "app.h"
 #include "wiced_bt_uuid.h"
 #include "wiced_bt_sdp_defs.h"
+#include "wiced_rtos.h"
 
 #define blehid_app_gatts_req_read_callback  android_gatts_req_read_callback
 #define blehid_app_gatts_req_write_callback android_gatts_req_write_callback
@@ -60,9 +61,49 @@ static uint8_t rpt_ref_bitmap[]             = {RPT_ID_IN_BIT_MAPPED,   WICED_HID
 static uint8_t rpt_ref_sleep[]              = {RPT_ID_IN_SLEEP,        WICED_HID_REPORT_TYPE_INPUT};
 static uint8_t rpt_ref_func_lock[]          = {RPT_ID_IN_FUNC_LOCK,    WICED_HID_REPORT_TYPE_INPUT};
 static uint8_t rpt_ref_scroll[]             = {RPT_ID_IN_SCROLL,       WICED_HID_REPORT_TYPE_INPUT};
+static uint8_t rpt_ref_consumer[]           = {RPT_ID_IN_CONSUMER,     WICED_HID_REPORT_TYPE_INPUT};
 static uint8_t rpt_ref_connection_ctrl[]    = {RPT_ID_FEATURE_CNT_CTL, WICED_HID_REPORT_TYPE_FEATURE}; //feature rpt
+#ifdef SUPPORT_KEY_STATS
+static uint8_t rpt_ref_key_stats[]          = {RPT_ID_FEATURE_KEY_STATS, WICED_HID_REPORT_TYPE_FEATURE}; //feature rpt
+#endif
 
 static uint8_t ble_dev_local_name[]          = BLE_LOCAL_NAME;
+
+/*****************************************************************************
+ * LE advertising and scan response data, fixed at compile time. The name is
+ * in the scan response to keep the advertising packets short.
+ ****************************************************************************/
+static const uint8_t  ble_adv_flag          = BTM_BLE_LIMITED_DISCOVERABLE_FLAG | BTM_BLE_BREDR_NOT_SUPPORTED;
+static const uint16_t ble_adv_appearance    = APPEARANCE_GENERIC_REMOTE_CONTROL;
+static const uint16_t ble_adv_service       = UUID_SERVCLASS_LE_HID;
+
+static const wiced_bt_ble_advert_elem_t ble_adv_data[] =
+{
+    {
+        .advert_type = BTM_BLE_ADVERT_TYPE_FLAG,
+        .len         = sizeof(ble_adv_flag),
+        .p_data      = (uint8_t *)&ble_adv_flag,
+    },
+    {
+        .advert_type = BTM_BLE_ADVERT_TYPE_APPEARANCE,
+        .len         = sizeof(ble_adv_appearance),
+        .p_data      = (uint8_t *)&ble_adv_appearance,
+    },
+    {
+        .advert_type = BTM_BLE_ADVERT_TYPE_16SRV_COMPLETE,
+        .len         = sizeof(ble_adv_service),
+        .p_data      = (uint8_t *)&ble_adv_service,
+    },
+};
+
+static const wiced_bt_ble_advert_elem_t ble_scan_rsp_data[] =
+{
+    {
+        .advert_type = BTM_BLE_ADVERT_TYPE_NAME_COMPLETE,
+        .len         = sizeof(BLE_LOCAL_NAME)-1,
+        .p_data      = ble_dev_local_name,
+    },
+};
 static uint8_t dev_hid_information[]        = {0x00, 0x01, 0x00, 0x00};  // Verison 1.00, Not localized, Cannot remote wake, not normally connectable
 static uint16_t dev_battery_service_uuid    = UUID_CHARACTERISTIC_BATTERY_LEVEL;
 #define INCLUDE_GATT_SERVICE_CHANGED 1
@@ -78,12 +119,51 @@ uint8_t rpt_descriptor_db[] = {USB_RPT_DESCRIPTOR};
 /*****************************************************************************
  * data for ble module
  ****************************************************************************/
+#define BLE_OTA_CONN_INTERVAL   6       // 6*1.25=7.5ms, shortest allowed
+#define BLE_MAX_TX_PDU_LEN      251     // longest LE data packet
+#define BLE_LINK_HOSTS          4       // hosts remembered for the link setup
+#define BLE_LINK_RETRY          8       // connections before asking 2M again from a host that refused it
+
+/// negotiated link parameters of a host
+#pragma pack(1)
+typedef struct {
+    wiced_bt_device_address_t bdAddr;   // bonded identity address
+    uint8_t txPhy;                      // negotiated PHY, 0 if not known
+    uint8_t rxPhy;
+    uint8_t phyStatus;                  // HCI status of the last PHY update
+    uint8_t retry;                      // connections left before asking 2M again
+    uint8_t txOctets;                   // negotiated data length, 0 if not known
+    uint8_t rxOctets;
+} ble_link_rec_t;
+#pragma pack()
+
 typedef struct {
     wiced_timer_t conn_param_update_timer;
+    uint8_t linkProfile;
+    uint8_t otaProfileRequests;             // OTA profile requests not released yet
+    wiced_bool_t recordsLoaded;
+    ble_link_rec_t link[BLE_LINK_HOSTS];    // most recent host first
+    uint8_t linkIdentified;                 // link[0] is the connected host
+    uint8_t linkDirty;                      // link records not saved yet
+    uint8_t txOctets;                       // data length of the connection, 0 until negotiated
+    uint8_t rxOctets;
+    wiced_bool_t reconnecting;
+    uint8_t advMode;                        // current advertising mode
+    uint8_t reconnectAdvMode;               // advertising mode the host reconnected on
+    uint8_t undirectedFallback;             // undirected advertising started by BLE_advertStateChanged
+    uint32_t reconnectStartBtClk;
+    uint8_t statsDirty;                     // reconnect statistics not saved yet
+    uint8_t statsSaveScheduled;             // save queued to the application thread
+    wiced_bool_t connected;             // the LE link is up, whichever link the reports go to
+#ifdef CONN_EVT_ALIGN
+    wiced_bool_t latencyCancelled;      // slave latency is off until the keys are quiet
+#endif
 } ble_data_t;
 
 static ble_data_t ble = {};
 
+ble_reconnect_stats_t bleReconnectStats = {};
+
 /******************************************************************************
  *                         handle Definitions
  ******************************************************************************/
@@ -115,6 +195,8 @@ typedef enum
         HANDLE_APP_BATTERY_SERVICE_CHAR_LEVEL_VAL, // char value handle
         HANDLE_APP_BATTERY_SERVICE_CHAR_CFG_DESCR, // charconfig desc handl
         HANDLE_APP_BATTERY_SERVICE_RPT_REF_DESCR, // char desc handl
+        HANDLE_APP_BATTERY_SERVICE_CHAR_RUNTIME, // characteristic handl
+        HANDLE_APP_BATTERY_SERVICE_CHAR_RUNTIME_VAL, // char value handle
 
     HANDLE_APP_SCAN_PARAM_SERVICE = 0x40, // service handle
         HANDLE_APP_SCAN_PARAM_SERVICE_CHAR_SCAN_INT_WINDOW, // characteristic handl
@@ -177,6 +259,15 @@ typedef enum
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_HID_CTRL_POINT,           // 0x77 characteristic handl
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_HID_CTRL_POINT_VAL,       // 0x78 char value handle
 
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER,                 // 0x79 characteristic handl
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_VAL,             // 0x7a char value handle
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_CHAR_CFG_DESCR,  // 0x7b charconfig desc handl
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_RPT_REF_DESCR,   // 0x7c char desc handl
+
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS,                // 0x7d characteristic handl
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS_VAL,            // 0x7e char value handle
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS_RPT_REF_DESCR,  // 0x7f char desc handl
+
 }HANDLE_APP_t;
 
 static uint16_t cccd[BLE_RPT_INDX_MAX] = {0,};
@@ -242,6 +333,12 @@ attribute_t blehid_gattAttributes[] =
         rpt_ref_battery     //fixed
     },
 
+    {
+        HANDLE_APP_BATTERY_SERVICE_CHAR_RUNTIME_VAL,
+        2,
+        &batRuntimeHours    //remaining runtime in hours
+    },
+
     {
         HANDLE_APP_LE_HID_SERVICE_PROTO_MODE_VAL,
         1,
@@ -257,7 +354,7 @@ attribute_t blehid_gattAttributes[] =
     {
         HANDLE_APP_LE_HID_SERVICE_HID_BT_KB_INPUT_VAL,
         sizeof(KeyboardStandardReport)-1,
-        &key_rpts.stdRpt.modifierKeys //updated everytime a std key input report sent
+        &key_snapshot.stdRpt.modifierKeys //updated everytime a std key input report sent
     },
 
     {
@@ -287,7 +384,7 @@ attribute_t blehid_gattAttributes[] =
     {
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_STD_INPUT_VAL,
         sizeof(KeyboardStandardReport)-1,
-        &key_rpts.stdRpt.modifierKeys //updated everytime a std key input report sent
+        &key_snapshot.stdRpt.modifierKeys //updated everytime a std key input report sent
     },
 
     {
@@ -317,7 +414,7 @@ attribute_t blehid_gattAttributes[] =
     {
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_BITMAP_VAL,
         sizeof(KeyboardBitMappedReport)-1,
-        &key_rpts.bitMappedReport.bitMappedKeys
+        &key_snapshot.bitMappedReport.bitMappedKeys
     },
 
     {
@@ -335,7 +432,7 @@ attribute_t blehid_gattAttributes[] =
     {
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_SLEEP_VAL,
         1,
-        &key_rpts.sleepReport.sleepVal
+        &key_snapshot.sleepReport.sleepVal
     },
 
     {
@@ -353,7 +450,7 @@ attribute_t blehid_gattAttributes[] =
     {
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_FUNC_LOCK_VAL,
         1,
-        &key_rpts.funcLockReport.status
+        &key_snapshot.funcLockReport.status
     },
 
     {
@@ -371,7 +468,7 @@ attribute_t blehid_gattAttributes[] =
     {
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_SCROLL_VAL,
         sizeof(KeyboardMotionReport)-1,
-        &key_rpts.scrollReport.motionAxis0
+        &key_snapshot.scrollReport.motionAxis0
     },
 
     {
@@ -386,6 +483,24 @@ attribute_t blehid_gattAttributes[] =
         rpt_ref_scroll  //fixed
     },
 
+    {
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_VAL,
+        sizeof(KeyboardConsumerReport)-1,
+        &key_snapshot.consumerReport.usage
+    },
+
+    {
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_CHAR_CFG_DESCR,
+        2,
+        &cccd[APP_CLIENT_CONFIG_NOTIF_CONSUMER_BIT]  //bit mask: APP_CLIENT_CONFIG_NOTIF_CONSUMER_RPT      (0x80)
+    },
+
+    {
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_RPT_REF_DESCR,
+        2,
+        rpt_ref_consumer    //fixed
+    },
+
     {
         HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONNECTION_CTRL_VAL,
         1,
@@ -397,6 +512,20 @@ attribute_t blehid_gattAttributes[] =
         2,
         rpt_ref_connection_ctrl //fixed
     },
+
+#ifdef SUPPORT_KEY_STATS
+    {
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS_VAL,
+        sizeof(KeyStatsReport)-1,
+        &keyStatsRpt.page
+    },
+
+    {
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS_RPT_REF_DESCR,
+        2,
+        rpt_ref_key_stats   //fixed
+    },
+#endif
 };
 const uint16_t blehid_gattAttributes_size = sizeof(blehid_gattAttributes)/sizeof(attribute_t);
 
@@ -519,6 +648,16 @@ uint8_t blehid_db_data[]=
         LEGATTDB_PERM_READABLE
     ),
 
+    // Handle 0x35: vendor characteristic remaining runtime, handle 0x36 characteristic value
+    CHARACTERISTIC_UUID128
+    (
+        HANDLE_APP_BATTERY_SERVICE_CHAR_RUNTIME,
+        HANDLE_APP_BATTERY_SERVICE_CHAR_RUNTIME_VAL,
+        UUID_BATTERY_RUNTIME,
+        LEGATTDB_CHAR_PROP_READ,
+        LEGATTDB_PERM_READABLE
+    ),
+
     // Declare Scan Parameters service
     PRIMARY_SERVICE_UUID16
     ( HANDLE_APP_SCAN_PARAM_SERVICE, UUID_SERVCLASS_SCAN_PARAM),
@@ -542,7 +681,7 @@ uint8_t blehid_db_data[]=
     (
         HANDLE_APP_LE_HID_SERVICE_INC_BAS_SERVICE,
         HANDLE_APP_BATTERY_SERVICE,
-        HANDLE_APP_BATTERY_SERVICE_RPT_REF_DESCR,
+        HANDLE_APP_BATTERY_SERVICE_CHAR_RUNTIME_VAL,
         UUID_SERVCLASS_BATTERY
     ),
 
@@ -803,8 +942,57 @@ uint8_t blehid_db_data[]=
         LEGATTDB_PERM_WRITE_CMD
     ),
 
-#ifdef OTA_FIRMWARE_UPGRADE
- #ifdef OTA_SECURE_FIRMWARE_UPGRADE
+    //Consumer control report
+    // Handle 0x79: characteristic HID Report, handle 0x7a characteristic value
+    CHARACTERISTIC_UUID16
+    (
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER,
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_VAL,
+        GATT_UUID_HID_REPORT,
+        LEGATTDB_CHAR_PROP_READ|LEGATTDB_CHAR_PROP_NOTIFY,
+        LEGATTDB_PERM_READABLE
+    ),
+
+    // Declare client specific characteristic cfg desc. // Value of the descriptor can be modified by the client
+    // Value modified shall be retained during connection and across connection // for bonded devices
+    CHAR_DESCRIPTOR_UUID16_WRITABLE
+    (
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_CHAR_CFG_DESCR,
+        GATT_UUID_CHAR_CLIENT_CONFIG,
+        LEGATTDB_PERM_READABLE|LEGATTDB_PERM_WRITE_CMD|LEGATTDB_PERM_WRITE_REQ
+    ),
+
+    // Handle 0x7c: report reference
+    CHAR_DESCRIPTOR_UUID16
+    (
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_RPT_REF_DESCR,
+        GATT_UUID_RPT_REF_DESCR,
+        LEGATTDB_PERM_READABLE
+    ),
+
+#ifdef SUPPORT_KEY_STATS
+    // Key statistics feature
+    // Handle 0x7d: characteristic HID Report, handle 0x7e characteristic value
+    CHARACTERISTIC_UUID16_WRITABLE
+    (
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS,
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS_VAL,
+        GATT_UUID_HID_REPORT,
+        LEGATTDB_CHAR_PROP_READ|LEGATTDB_CHAR_PROP_WRITE,
+        LEGATTDB_PERM_READABLE|LEGATTDB_PERM_WRITE_REQ
+    ),
+
+    // Handle 0x7f: report reference
+    CHAR_DESCRIPTOR_UUID16
+    (
+        HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS_RPT_REF_DESCR,
+        GATT_UUID_RPT_REF_DESCR,
+        LEGATTDB_PERM_READABLE
+    ),
+#endif
+
+#ifdef APP_OTA_FW_UPGRADE
+ #ifdef APP_OTA_SEC_FW_UPGRADE
     // Handle 0xff00: Cypress vendor specific WICED Secure OTA Upgrade Service.
     PRIMARY_SERVICE_UUID128
     ( HANDLE_OTA_FW_UPGRADE_SERVICE, UUID_OTA_SEC_FW_UPGRADE_SERVICE ),
@@ -847,6 +1035,41 @@ uint8_t blehid_db_data[]=
         LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_REQ | LEGATTDB_PERM_RELIABLE_WRITE
     ),
 #endif
+
+#ifdef SUPPORT_KEYMAP
+    // Handle 0xff20: vendor specific keymap upload service
+    PRIMARY_SERVICE_UUID128
+    ( HANDLE_KEYMAP_SERVICE, UUID_KEYMAP_SERVICE ),
+
+    // Handle 0xff21: characteristic control point, handle 0xff22 characteristic value
+    CHARACTERISTIC_UUID128_WRITABLE
+    (
+        HANDLE_KEYMAP_CHARACTERISTIC_CONTROL_POINT,
+        HANDLE_KEYMAP_CONTROL_POINT,
+        UUID_KEYMAP_CHARACTERISTIC_CONTROL_POINT,
+        LEGATTDB_CHAR_PROP_WRITE | LEGATTDB_CHAR_PROP_NOTIFY,
+        LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_REQ
+    ),
+
+    // Handle 0xff23: control point client configuration
+    CHAR_DESCRIPTOR_UUID16_WRITABLE
+    (
+        HANDLE_KEYMAP_CLIENT_CONFIGURATION_DESCRIPTOR,
+        UUID_DESCRIPTOR_CLIENT_CHARACTERISTIC_CONFIGURATION,
+        LEGATTDB_PERM_READABLE | LEGATTDB_PERM_WRITE_REQ
+    ),
+
+    // Handle 0xff24: characteristic data, handle 0xff25 characteristic value.
+    // Written without response, up to the ATT MTU per write.
+    CHARACTERISTIC_UUID128_WRITABLE
+    (
+        HANDLE_KEYMAP_CHARACTERISTIC_DATA,
+        HANDLE_KEYMAP_DATA,
+        UUID_KEYMAP_CHARACTERISTIC_DATA,
+        LEGATTDB_CHAR_PROP_WRITE_NO_RESPONSE,
+        LEGATTDB_PERM_VARIABLE_LENGTH | LEGATTDB_PERM_WRITE_CMD
+    ),
+#endif
 };
 const uint16_t blehid_db_size = sizeof(blehid_db_data);
 
@@ -864,6 +1087,8 @@ const uint16_t blehid_db_size = sizeof(blehid_db_data);
  *******************************************************************************/
 STATIC void BLE_connparamupdate_timeout( uint32_t arg )
 {
+    sleep_clear_deadline(SLEEP_DEADLINE_CONN_PARAM);
+
     //request connection param update if it not requested before
     if ( !hidd_blelink_conn_param_updated()
          // if we are not in the middle of OTAFWU
@@ -1064,6 +1289,31 @@ STATIC void BLE_clientConfWriteScroll(wiced_hidd_report_type_t reportType,
     ble_updateClientConfFlags(notification, APP_CLIENT_CONFIG_NOTIF_SCROLL_RPT);
 }
 
+/********************************************************************************
+ * Function Name: BLE_clientConfWriteConsumer
+ ********************************************************************************
+ * Summary: Client characteritics conf write handler for Consumer control report
+ *
+ * Parameters:
+ *   reportType -- Report type
+ *   reportId -- Report ID
+ *   payload -- pointer to payload
+ *   payloadSize -- payload size
+ *
+ * Return:
+ *   none
+ *
+ *******************************************************************************/
+STATIC void BLE_clientConfWriteConsumer(wiced_hidd_report_type_t reportType,
+                                 uint8_t reportId,
+                                 void *payload,
+                                 uint16_t payloadSize)
+{
+    uint8_t  notification = *(uint16_t *)payload & GATT_CLIENT_CONFIG_NOTIFICATION;
+
+    ble_updateClientConfFlags(notification, APP_CLIENT_CONFIG_NOTIF_CONSUMER_RPT);
+}
+
 /********************************************************************************
  * Function Name: BLE_ctrlPointWrite
  ********************************************************************************
@@ -1090,173 +1340,192 @@ STATIC void BLE_ctrlPointWrite(wiced_hidd_report_type_t reportType,
 }
 
 /********************************************************************************
- * Gatt Map for Report Mode
+ * Report characteristic value handles, by report registry index. Reports
+ * without a handle are not exposed over LE.
  ********************************************************************************/
-static wiced_blehidd_report_gatt_characteristic_t reportModeGattMap[] =
+static const uint16_t BLE_reportHandle[RPT_IDX_MAX] =
 {
-    // STD keyboard Input report
-    {
-        .reportId           =RPT_ID_IN_STD_KEY,
-        .reportType         =WICED_HID_REPORT_TYPE_INPUT,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_STD_INPUT_VAL,
-        .sendNotification   =FALSE,
-        .writeCallback      =NULL,
-        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_STD_RPT
-    },
+    [RPT_IDX_STD_KEY]       = HANDLE_APP_LE_HID_SERVICE_HID_RPT_STD_INPUT_VAL,
+    [RPT_IDX_KB_LED]        = HANDLE_APP_LE_HID_SERVICE_HID_RPT_STD_OUTPUT_VAL,
+    [RPT_IDX_BATTERY]       = HANDLE_APP_BATTERY_SERVICE_CHAR_LEVEL_VAL,
+    [RPT_IDX_BIT_MAPPED]    = HANDLE_APP_LE_HID_SERVICE_HID_RPT_BITMAP_VAL,
+    [RPT_IDX_SLEEP]         = HANDLE_APP_LE_HID_SERVICE_HID_RPT_SLEEP_VAL,
+    [RPT_IDX_FUNC_LOCK]     = HANDLE_APP_LE_HID_SERVICE_HID_RPT_FUNC_LOCK_VAL,
+    [RPT_IDX_SCROLL]        = HANDLE_APP_LE_HID_SERVICE_HID_RPT_SCROLL_VAL,
+    [RPT_IDX_CONSUMER]      = HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_VAL,
+    [RPT_IDX_CNT_CTL]       = HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONNECTION_CTRL_VAL,
+#ifdef SUPPORT_KEY_STATS
+    [RPT_IDX_KEY_STATS]     = HANDLE_APP_LE_HID_SERVICE_HID_RPT_KEY_STATS_VAL,
+#endif
+};
 
-    // Std output report
+/********************************************************************************
+ * Gatt Map for Report Mode, entries other than reports. The report entries are
+ * built from the report registry, see BLE_buildReportModeGattMap().
+ ********************************************************************************/
+static const wiced_blehidd_report_gatt_characteristic_t BLE_otherGattMap[] =
+{
     {
-        .reportId           =RPT_ID_OUT_KB_LED,
-        .reportType         =WICED_HID_REPORT_TYPE_OUTPUT,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_STD_OUTPUT_VAL,
+        .reportId           =RPT_ID_NOT_USED,
+        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_HID_CTRL_POINT_VAL,
         .sendNotification   =FALSE,
-        .writeCallback      =app_setReport,
+        .writeCallback      =BLE_ctrlPointWrite,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
-    // Battery Input report
     {
-        .reportId           =RPT_ID_IN_BATTERY,
-        .reportType         =WICED_HID_REPORT_TYPE_INPUT,
-        .handle             =HANDLE_APP_BATTERY_SERVICE_CHAR_LEVEL_VAL,
+        .reportId           =RPT_ID_NOT_USED,
+        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_PROTO_MODE_VAL,
         .sendNotification   =FALSE,
-        .writeCallback      =NULL,
-        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_BATTERY_RPT
+        .writeCallback      =app_setProtocol,
+        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
-    //Bitmapped report
     {
-        .reportId           =RPT_ID_IN_BIT_MAPPED,
-        .reportType         =WICED_HID_REPORT_TYPE_INPUT,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_BITMAP_VAL,
+        .reportId           =RPT_ID_NOT_USED,
+        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
+        .handle             =HANDLE_APP_BATTERY_SERVICE_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =NULL,
-        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_BIT_MAPPED_RPT
+        .writeCallback      =BLE_clientConfWriteBatteryRpt,
+        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
-    //sleep report
     {
-        .reportId           =RPT_ID_IN_SLEEP,
-        .reportType         =WICED_HID_REPORT_TYPE_INPUT,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_SLEEP_VAL,
+        .reportId           =RPT_ID_NOT_USED,
+        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_STD_INPUT_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =NULL,
-        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_SLP_RPT
+        .writeCallback      =BLE_clientConfWriteRptStd,
+        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
-    //func lock report
     {
-        .reportId           =RPT_ID_IN_FUNC_LOCK,
-        .reportType         =WICED_HID_REPORT_TYPE_INPUT,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_FUNC_LOCK_VAL,
+        .reportId           =RPT_ID_NOT_USED,
+        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_BITMAP_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =NULL,
-        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_FUNC_LOCK_RPT
+        .writeCallback      =BLE_clientConfWriteRptBitMapped,
+        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
-    //scroll report
     {
-        .reportId           =RPT_ID_IN_SCROLL,
-        .reportType         =WICED_HID_REPORT_TYPE_INPUT,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_SCROLL_VAL,
+        .reportId           =RPT_ID_NOT_USED,
+        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_SLEEP_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =NULL,
-        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_SCROLL_RPT
+        .writeCallback      =BLE_clientConfWriteRptSlp,
+        .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
-    //connection control feature
     {
-        .reportId           =RPT_ID_IN_CNT_CTL,
-        .reportType         =WICED_HID_REPORT_TYPE_FEATURE,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONNECTION_CTRL_VAL,
+        .reportId           =RPT_ID_NOT_USED,
+        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_FUNC_LOCK_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =app_setReport,
+        .writeCallback      =BLE_clientConfWriteRptFuncLock,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
     {
         .reportId           =RPT_ID_NOT_USED,
-        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_HID_CTRL_POINT_VAL,
+        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_SCROLL_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_ctrlPointWrite,
+        .writeCallback      =BLE_clientConfWriteScroll,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
     {
         .reportId           =RPT_ID_NOT_USED,
-        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_PROTO_MODE_VAL,
+        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_CONSUMER_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =app_setProtocol,
+        .writeCallback      =BLE_clientConfWriteConsumer,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
+    //Boot keyboard input client conf write
     {
         .reportId           =RPT_ID_NOT_USED,
         .reportType         =WICED_HID_CLIENT_CHAR_CONF,
-        .handle             =HANDLE_APP_BATTERY_SERVICE_CHAR_CFG_DESCR,
+        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_BT_KB_INPUT_CHAR_CFG_DESCR,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_clientConfWriteBatteryRpt,
+        .writeCallback      =BLE_clientConfWriteBootMode,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
+#ifdef APP_OTA_FW_UPGRADE
+    //OTA control point write
     {
         .reportId           =RPT_ID_NOT_USED,
-        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_STD_INPUT_CHAR_CFG_DESCR,
+        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
+        .handle             =HANDLE_OTA_FW_UPGRADE_CONTROL_POINT,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_clientConfWriteRptStd,
+        .writeCallback      =ota_controlPointWrite,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
+    //OTA control point client conf write
     {
         .reportId           =RPT_ID_NOT_USED,
         .reportType         =WICED_HID_CLIENT_CHAR_CONF,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_BITMAP_CHAR_CFG_DESCR,
+        .handle             =HANDLE_OTA_FW_UPGRADE_CLIENT_CONFIGURATION_DESCRIPTOR,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_clientConfWriteRptBitMapped,
+        .writeCallback      =ota_clientConfWrite,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
+    //OTA data write
     {
         .reportId           =RPT_ID_NOT_USED,
-        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_SLEEP_CHAR_CFG_DESCR,
+        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
+        .handle             =HANDLE_OTA_FW_UPGRADE_DATA,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_clientConfWriteRptSlp,
+        .writeCallback      =ota_dataWrite,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
+#endif
 
+#ifdef SUPPORT_KEYMAP
+    //Keymap control point write
     {
         .reportId           =RPT_ID_NOT_USED,
-        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_FUNC_LOCK_CHAR_CFG_DESCR,
+        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
+        .handle             =HANDLE_KEYMAP_CONTROL_POINT,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_clientConfWriteRptFuncLock,
+        .writeCallback      =keymap_controlPointWrite,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
+    //Keymap control point client conf write
     {
         .reportId           =RPT_ID_NOT_USED,
         .reportType         =WICED_HID_CLIENT_CHAR_CONF,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_RPT_SCROLL_CHAR_CFG_DESCR,
+        .handle             =HANDLE_KEYMAP_CLIENT_CONFIGURATION_DESCRIPTOR,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_clientConfWriteScroll,
+        .writeCallback      =keymap_clientConfWrite,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
 
-    //Boot keyboard input client conf write
+    //Keymap data write
     {
         .reportId           =RPT_ID_NOT_USED,
-        .reportType         =WICED_HID_CLIENT_CHAR_CONF,
-        .handle             =HANDLE_APP_LE_HID_SERVICE_HID_BT_KB_INPUT_CHAR_CFG_DESCR,
+        .reportType         =WICED_HID_REPORT_TYPE_OTHER,
+        .handle             =HANDLE_KEYMAP_DATA,
         .sendNotification   =FALSE,
-        .writeCallback      =BLE_clientConfWriteBootMode,
+        .writeCallback      =keymap_dataWrite,
         .clientConfigBitmap =APP_CLIENT_CONFIG_NOTIF_NONE
     },
+#endif
 };
 
+#define BLE_OTHER_GATT_MAP_SIZE (sizeof(BLE_otherGattMap)/sizeof(BLE_otherGattMap[0]))
+
+static wiced_blehidd_report_gatt_characteristic_t reportModeGattMap[RPT_IDX_MAX + BLE_OTHER_GATT_MAP_SIZE];
+static uint8_t reportModeGattMapSize;
+
 /********************************************************************************
  * Gatt Map for Boot Mode
  ********************************************************************************/
@@ -1302,6 +1571,43 @@ static wiced_blehidd_report_gatt_characteristic_t bootModeGattMap[] =
     },
 };
 
+/********************************************************************************
+ * Function Name: BLE_buildReportModeGattMap
+ ********************************************************************************
+ * Summary: Build the report mode GATT map from the report registry
+ *
+ * Parameters:
+ *   none
+ *
+ * Return:
+ *   none
+ *
+ *******************************************************************************/
+STATIC void BLE_buildReportModeGattMap(void)
+{
+    wiced_blehidd_report_gatt_characteristic_t* map = reportModeGattMap;
+    const report_entry_t * rpt;
+    uint8_t idx;
+
+    for (idx = RPT_IDX_NONE + 1; idx < RPT_IDX_MAX; idx++)
+    {
+        if (BLE_reportHandle[idx])
+        {
+            rpt = &report_table[idx];
+            map->reportId           = rpt->id;
+            map->reportType         = rpt->type;
+            map->handle             = BLE_reportHandle[idx];
+            map->sendNotification   = FALSE;
+            map->writeCallback      = rpt->set;
+            map->clientConfigBitmap = rpt->cccdBitmap;
+            map++;
+        }
+    }
+
+    memcpy(map, BLE_otherGattMap, sizeof(BLE_otherGattMap));
+    reportModeGattMapSize = (map - reportModeGattMap) + BLE_OTHER_GATT_MAP_SIZE;
+}
+
 /********************************************************************************
  * Function Name: BLE_updateGattMapWithNotifications
  ********************************************************************************
@@ -1325,7 +1631,7 @@ STATIC void BLE_updateGattMapWithNotifications(uint16_t flags)
         cccd[i] = (flags >> i) & GATT_CLIENT_CONFIG_NOTIFICATION;
     }
 
-    for(i = 0; i < sizeof(reportModeGattMap)/sizeof(reportModeGattMap[0]); i++)
+    for(i = 0; i < reportModeGattMapSize; i++)
     {
         if(map->reportType == WICED_HID_REPORT_TYPE_INPUT)
         {
@@ -1338,23 +1644,412 @@ STATIC void BLE_updateGattMapWithNotifications(uint16_t flags)
 }
 
 /********************************************************************************
- * Function Name: BLE_transportStateChangeNotification
+ * Function Name: BLE_loadRecords
  ********************************************************************************
- * Summary: This function informs the application that the state of a link changed.
+ * Summary: Read the link records and reconnect statistics from the journal the
+ *          first time they are needed
  *
  * Parameters:
- *   newState -- new state of the link
+ *  none
  *
  * Return:
- *   none
+ *  none
  *
  *******************************************************************************/
-STATIC void BLE_transportStateChangeNotification(uint32_t newState)
+STATIC void BLE_loadRecords(void)
 {
-    int16_t flags;
-
+    if (!ble.recordsLoaded)
+    {
+        // records of another layout are dropped
+        if (journal_read(JOURNAL_REC_LE_LINK, ble.link, sizeof(ble.link)) != sizeof(ble.link))
+        {
+            memset(ble.link, 0, sizeof(ble.link));
+        }
+        journal_read(JOURNAL_REC_LE_RECONNECT, &bleReconnectStats, sizeof(bleReconnectStats));
+        ble.recordsLoaded = TRUE;
+    }
+}
+
+/********************************************************************************
+ * Function Name: BLE_linkRecord
+ ********************************************************************************
+ * Summary: Get the link record of a host and make it the most recent one. A new
+ *          host takes the place of the oldest one.
+ *
+ * Parameters:
+ *  bdAddr -- identity address of the host
+ *
+ * Return:
+ *  link record of the host
+ *
+ *******************************************************************************/
+STATIC ble_link_rec_t * BLE_linkRecord(const uint8_t * bdAddr)
+{
+    ble_link_rec_t rec = {};
+    uint8_t i;
+
+    BLE_loadRecords();
+
+    for (i = 0; i < BLE_LINK_HOSTS - 1; i++)
+    {
+        if (!memcmp(ble.link[i].bdAddr, bdAddr, BD_ADDR_LEN))
+        {
+            break;
+        }
+    }
+
+    if (!memcmp(ble.link[i].bdAddr, bdAddr, BD_ADDR_LEN))
+    {
+        rec = ble.link[i];
+    }
+    else
+    {
+        memcpy(rec.bdAddr, bdAddr, BD_ADDR_LEN);
+    }
+
+    memmove(&ble.link[1], &ble.link[0], i * sizeof(ble_link_rec_t));
+    ble.link[0] = rec;
+    return &ble.link[0];
+}
+
+/********************************************************************************
+ * Function Name: BLE_typingPhys
+ ********************************************************************************
+ * Summary: PHYs to ask for while typing. 2M cuts the air time of each report,
+ *          unless the connected host refused it lately.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  PHY preference bits
+ *
+ *******************************************************************************/
+STATIC uint8_t BLE_typingPhys(void)
+{
+    if (ble.linkIdentified && ble.link[0].phyStatus && ble.link[0].retry)
+    {
+        return BTM_BLE_PREFER_1M_PHY;
+    }
+    return BTM_BLE_PREFER_1M_PHY | BTM_BLE_PREFER_2M_PHY;
+}
+
+/********************************************************************************
+ * Function Name: BLE_linkSetup
+ ********************************************************************************
+ * Summary: Ask for the longest data packets on a new connection. The controller
+ *          stays on 27 byte packets for a host that does not support them.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BLE_linkSetup(void)
+{
+    ble.linkIdentified = FALSE;
+    ble.txOctets = ble.rxOctets = 0;
+    wiced_bt_ble_set_data_packet_length(hidd_blelink.gatts_peer_addr, BLE_MAX_TX_PDU_LEN);
+}
+
+/********************************************************************************
+ * Function Name: BLE_linkIdentified
+ ********************************************************************************
+ * Summary: The link is encrypted, the host is known by its identity address.
+ *          Its record keeps the same key when its private address changes.
+ *          Ask for 2M PHY unless the host refused it lately, the controller
+ *          stays on 1M for a host that does not support it.
+ *
+ * Parameters:
+ *  bdAddr -- identity address of the host
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BLE_linkIdentified(const uint8_t * bdAddr)
+{
+    ble_link_rec_t * rec;
+    wiced_bt_ble_phy_preferences_t phy = {};
+
+    // the link can be encrypted again later on, set it up once
+    if (ble.linkIdentified)
+    {
+        return;
+    }
+    rec = BLE_linkRecord(bdAddr);
+    ble.linkIdentified = TRUE;
+    ble.linkDirty = TRUE;
+    if (ble.txOctets)
+    {
+        rec->txOctets = ble.txOctets;
+        rec->rxOctets = ble.rxOctets;
+    }
+
+    if (rec->phyStatus && rec->retry)
+    {
+        // refused last time, stay on 1M for a few more connections
+        WICED_BT_TRACE("\n2M PHY skipped, %d", rec->retry);
+        rec->retry--;
+        return;
+    }
+
+    memcpy(phy.remote_bd_addr, hidd_blelink.gatts_peer_addr, BD_ADDR_LEN);
+    phy.phy_opts = BTM_BLE_PREFER_NO_LELR;
+    phy.tx_phys = phy.rx_phys = BTM_BLE_PREFER_1M_PHY | BTM_BLE_PREFER_2M_PHY;
+    wiced_bt_ble_set_phy(&phy);
+}
+
+/********************************************************************************
+ * Function Name: BLE_phyUpdated
+ ********************************************************************************
+ * Summary: Record the PHY the connected host agreed on
+ *
+ * Parameters:
+ *  p_phy -- PHY update event data
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BLE_phyUpdated(wiced_bt_ble_phy_update_t * p_phy)
+{
+    ble_link_rec_t * rec = &ble.link[0];
+
+    WICED_BT_TRACE("\nPHY tx:%d rx:%d status:%d", p_phy->tx_phy, p_phy->rx_phy, p_phy->status);
+
+    if (!ble.linkIdentified)
+    {
+        return;
+    }
+
+    rec->phyStatus = p_phy->status;
+    if (p_phy->status == HCI_SUCCESS)
+    {
+        rec->txPhy = p_phy->tx_phy;
+        rec->rxPhy = p_phy->rx_phy;
+        rec->retry = 0;
+    }
+    else
+    {
+        rec->txPhy = rec->rxPhy = 1;    // link stays on 1M
+        rec->retry = BLE_LINK_RETRY;
+    }
+    ble.linkDirty = TRUE;
+}
+
+/********************************************************************************
+ * Function Name: BLE_dataLengthUpdated
+ ********************************************************************************
+ * Summary: Record the data length the connected host agreed on
+ *
+ * Parameters:
+ *  p_len -- data length update event data
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BLE_dataLengthUpdated(wiced_bt_ble_data_length_update_t * p_len)
+{
+    WICED_BT_TRACE("\ndata length tx:%d rx:%d", p_len->max_tx_octets, p_len->max_rx_octets);
+
+    // the update usually comes before the link is encrypted, the record takes it then
+    ble.txOctets = p_len->max_tx_octets;
+    ble.rxOctets = p_len->max_rx_octets;
+    if (ble.linkIdentified)
+    {
+        ble.link[0].txOctets = ble.txOctets;
+        ble.link[0].rxOctets = ble.rxOctets;
+        ble.linkDirty = TRUE;
+    }
+}
+
+/********************************************************************************
+ * Function Name: BLE_advertStateChanged
+ ********************************************************************************
+ * Summary: Reconnection advertising policy. The bonded host is reconnected with
+ *          a short burst of high duty directed advertising. When the burst is
+ *          over, low duty undirected advertising takes over, so a host that
+ *          changed its private address can still come back. It only runs
+ *          within hidd_link's reconnect window and ends with it.
+ *
+ * Parameters:
+ *  mode -- new advertising mode
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BLE_advertStateChanged(uint8_t mode)
+{
+    uint8_t prevMode = ble.advMode;
+
+    ble.advMode = mode;
+    if (mode == BTM_BLE_ADVERT_OFF)
+    {
+        ble.undirectedFallback = FALSE;
+    }
+    if (ble.reconnecting && hidd_link_is_reconnect_timer_running() &&
+        prevMode == BTM_BLE_ADVERT_DIRECTED_HIGH && mode == BTM_BLE_ADVERT_DIRECTED_LOW)
+    {
+        WICED_BT_TRACE("\ndirected burst over, undirected low duty");
+        ble.undirectedFallback = (wiced_bt_start_advertisements(BTM_BLE_ADVERT_UNDIRECTED_LOW, 0, NULL) == WICED_BT_SUCCESS);
+    }
+
+    if (mode != BTM_BLE_ADVERT_OFF)
+    {
+        ble.reconnectAdvMode = mode;
+    }
+}
+
+/********************************************************************************
+ * Function Name: BLE_reconnectDone
+ ********************************************************************************
+ * Summary: Update the time to reconnect statistics. They are kept in RAM here,
+ *          the journal write waits for ble_statsSave(), off the connection path.
+ *
+ * Parameters:
+ *  connected -- TRUE if the host reconnected, FALSE if the reconnection was given up
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BLE_reconnectDone(wiced_bool_t connected)
+{
+    uint32_t ms = BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(ble.reconnectStartBtClk));
+
+    ble.reconnecting = FALSE;
+    BLE_loadRecords();
+
+    if (connected)
+    {
+        bleReconnectStats.count++;
+        if (ble.reconnectAdvMode == BTM_BLE_ADVERT_DIRECTED_HIGH)
+        {
+            bleReconnectStats.directed++;
+        }
+        bleReconnectStats.total_ms += ms;
+        bleReconnectStats.last_ms = ms;
+        if (ms > bleReconnectStats.max_ms)
+        {
+            bleReconnectStats.max_ms = ms;
+        }
+        WICED_BT_TRACE("\nreconnected in %d ms (%d of %d directed, max %d ms)", ms,
+                        bleReconnectStats.directed, bleReconnectStats.count, bleReconnectStats.max_ms);
+    }
+    else
+    {
+        bleReconnectStats.failed++;
+    }
+    ble.statsDirty = TRUE;
+}
+
+/********************************************************************************
+ * Function Name: void ble_statsSave(void)
+ ********************************************************************************
+ * Summary: Write the link records and the reconnect statistics to the journal
+ *          if they changed
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ble_statsSave(void)
+{
+    if (ble.linkDirty && journal_write(JOURNAL_REC_LE_LINK, ble.link, sizeof(ble.link)))
+    {
+        ble.linkDirty = FALSE;
+    }
+    if (ble.statsDirty && journal_write(JOURNAL_REC_LE_RECONNECT, &bleReconnectStats, sizeof(bleReconnectStats)))
+    {
+        ble.statsDirty = FALSE;
+    }
+}
+
+/********************************************************************************
+ * Function Name: BLE_statsSaveEvt
+ ********************************************************************************
+ * Summary: save queued by ble_statsReadyForSleep()
+ *
+ * Parameters:
+ *  data -- not used
+ *
+ * Return:
+ *  0
+ *
+ *******************************************************************************/
+STATIC int BLE_statsSaveEvt(void * data)
+{
+    ble.statsSaveScheduled = FALSE;
+    ble_statsSave();
+
+    // a failed save does not hold deep sleep off
+    ble.linkDirty = FALSE;
+    ble.statsDirty = FALSE;
+    return 0;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t ble_statsReadyForSleep(void)
+ ********************************************************************************
+ * Summary: Check the link records and reconnect statistics before deep sleep.
+ *          Unsaved ones are saved from the application thread, not from the
+ *          sleep callback.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if nothing is left to save
+ *
+ *******************************************************************************/
+wiced_bool_t ble_statsReadyForSleep(void)
+{
+    if (!ble.linkDirty && !ble.statsDirty)
+    {
+        return TRUE;
+    }
+
+    if (!ble.statsSaveScheduled)
+    {
+        ble.statsSaveScheduled = wiced_app_event_serialize(BLE_statsSaveEvt, NULL);
+    }
+    return FALSE;
+}
+
+/********************************************************************************
+ * Function Name: BLE_transportStateChangeNotification
+ ********************************************************************************
+ * Summary: This function informs the application that the state of a link changed.
+ *
+ * Parameters:
+ *   newState -- new state of the link
+ *
+ * Return:
+ *   none
+ *
+ *******************************************************************************/
+STATIC void BLE_transportStateChangeNotification(uint32_t newState)
+{
+    int16_t flags;
+
     switch (newState) {
     case HIDLINK_LE_CONNECTED:
+        ble.linkProfile = BLE_LINK_PROFILE_TYPING;
+        if (ble.reconnecting)
+        {
+            BLE_reconnectDone(TRUE);
+        }
+        BLE_linkSetup();
+        ble.connected = TRUE;
+
         //get host client configuration characteristic descriptor values
         flags = hidd_host_get_flags(hidd_blelink.gatts_peer_addr, hidd_blelink.gatts_peer_addr_type);
         if(flags != -1)
@@ -1369,12 +2064,52 @@ STATIC void BLE_transportStateChangeNotification(uint32_t newState)
 
         //start 15 second timer to make sure connection param update is requested before SDS
         wiced_start_timer(&ble.conn_param_update_timer,15000); //15 seconds. timeout in ms
+        sleep_post_deadline(SLEEP_DEADLINE_CONN_PARAM, 15000);
+        break;
+
+    case HIDLINK_LE_RECONNECTING:
+        if (!ble.reconnecting)
+        {
+            ble.reconnecting = TRUE;
+            ble.reconnectAdvMode = BTM_BLE_ADVERT_OFF;
+            ble.reconnectStartBtClk = wiced_hidd_get_current_native_bt_clocks();
+        }
         break;
 
     case HIDLINK_LE_DISCONNECTED:
+        if (ble.reconnecting)
+        {
+            BLE_reconnectDone(FALSE);
+        }
+
+        ble.linkIdentified = FALSE;
+
+        // hidd_link gave up, the undirected fallback goes with it
+        if (ble.undirectedFallback)
+        {
+            ble.undirectedFallback = FALSE;
+            wiced_bt_start_advertisements(BTM_BLE_ADVERT_OFF, 0, NULL);
+        }
+
         //allow Shut Down Sleep (SDS) only if we are not attempting reconnect
         if (!hidd_link_is_reconnect_timer_running())
-            hidd_deep_sleep_not_allowed(2000); // 2 seconds. timeout in ms
+            sleep_deep_sleep_not_allowed(2000); // 2 seconds. timeout in ms
+
+        wiced_stop_timer(&ble.conn_param_update_timer);
+        sleep_clear_deadline(SLEEP_DEADLINE_CONN_PARAM);
+
+        // the link is gone before the OTA and keymap cleanups set the link profile
+        ble.connected = FALSE;
+        ota_disconnected();
+        keymap_disconnected();
+
+#ifdef CONN_EVT_ALIGN
+        if (ble.latencyCancelled)
+        {
+            ble.latencyCancelled = FALSE;
+            wiced_blehidd_allow_slave_latency(TRUE);
+        }
+#endif
         break;
 
     }
@@ -1386,7 +2121,7 @@ STATIC void BLE_transportStateChangeNotification(uint32_t newState)
 /********************************************************************************
  * Function Name: void BLE_setUpAdvData(void)
  ********************************************************************************
- * Summary: set up LE Advertising data
+ * Summary: set up LE Advertising and scan response data
  *
  * Parameters:
  *  none
@@ -1397,32 +2132,172 @@ STATIC void BLE_transportStateChangeNotification(uint32_t newState)
  *******************************************************************************/
 STATIC void BLE_setUpAdvData(void)
 {
-    wiced_bt_ble_advert_elem_t app_adv_elem[4];
-    uint8_t app_adv_flag         = BTM_BLE_LIMITED_DISCOVERABLE_FLAG | BTM_BLE_BREDR_NOT_SUPPORTED;
-    uint16_t app_adv_appearance  = APPEARANCE_GENERIC_REMOTE_CONTROL;
-    uint16_t app_adv_service     = UUID_SERVCLASS_LE_HID;
-
-    // flag
-    app_adv_elem[0].advert_type  = BTM_BLE_ADVERT_TYPE_FLAG;
-    app_adv_elem[0].len          = sizeof(uint8_t);
-    app_adv_elem[0].p_data       = &app_adv_flag;
-
-    // Appearance
-    app_adv_elem[1].advert_type  = BTM_BLE_ADVERT_TYPE_APPEARANCE;
-    app_adv_elem[1].len          = sizeof(uint16_t);
-    app_adv_elem[1].p_data       = (uint8_t *)&app_adv_appearance;
-
-    //16 bits Service: UUID_SERVCLASS_LE_HID
-    app_adv_elem[2].advert_type  = BTM_BLE_ADVERT_TYPE_16SRV_COMPLETE;
-    app_adv_elem[2].len          = sizeof(uint16_t);
-    app_adv_elem[2].p_data       = (uint8_t *)&app_adv_service;
-
-    //dev name
-    app_adv_elem[3].advert_type  = BTM_BLE_ADVERT_TYPE_NAME_COMPLETE;
-    app_adv_elem[3].len          = sizeof(BLE_LOCAL_NAME)-1;
-    app_adv_elem[3].p_data       = (uint8_t *)ble_dev_local_name;
-
-    wiced_bt_ble_set_raw_advertisement_data(4, app_adv_elem);
+    wiced_bt_ble_set_raw_advertisement_data(sizeof(ble_adv_data)/sizeof(ble_adv_data[0]),
+                                            (wiced_bt_ble_advert_elem_t *)ble_adv_data);
+    wiced_bt_ble_set_raw_scan_response_data(sizeof(ble_scan_rsp_data)/sizeof(ble_scan_rsp_data[0]),
+                                            (wiced_bt_ble_advert_elem_t *)ble_scan_rsp_data);
+}
+
+/********************************************************************************
+ * Function Name: void ble_set_link_profile(uint8_t profile)
+ ********************************************************************************
+ * Summary: Switch the LE link between the typing profile (preferred connection
+ *          parameters, slave latency, 1M PHY) and the OTA profile (shortest
+ *          interval, no latency, longest data packets and 2M PHY where the
+ *          host supports it). Each OTA profile request is released by a typing
+ *          one, the link goes back to typing when the last one is released.
+ *
+ * Parameters:
+ *  profile -- BLE_LINK_PROFILE_TYPING or BLE_LINK_PROFILE_OTA
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ble_set_link_profile(uint8_t profile)
+{
+    wiced_bt_ble_phy_preferences_t phy = {};
+
+    // an OTA and a keymap upload can overlap, neither ends the other's fast link
+    if (profile == BLE_LINK_PROFILE_OTA)
+    {
+        ble.otaProfileRequests++;
+    }
+    else if (ble.otaProfileRequests)
+    {
+        ble.otaProfileRequests--;
+    }
+    profile = ble.otaProfileRequests ? BLE_LINK_PROFILE_OTA : BLE_LINK_PROFILE_TYPING;
+
+    // with DUAL_HOST the connected link can be BR/EDR only, the LE peer address is stale then
+    if (!ble.connected || (ble.linkProfile == profile))
+    {
+        return;
+    }
+
+    ble.linkProfile = profile;
+    memcpy(phy.remote_bd_addr, hidd_blelink.gatts_peer_addr, BD_ADDR_LEN);
+    phy.phy_opts = BTM_BLE_PREFER_NO_LELR;
+
+    if (profile == BLE_LINK_PROFILE_OTA)
+    {
+        WICED_BT_TRACE("\nOTA link profile");
+        wiced_bt_l2cap_update_ble_conn_params(hidd_blelink.gatts_peer_addr,
+                                              BLE_OTA_CONN_INTERVAL,
+                                              BLE_OTA_CONN_INTERVAL,
+                                              0,
+                                              bt_cfg.ble_scan_cfg.conn_supervision_timeout);
+        wiced_bt_ble_set_data_packet_length(hidd_blelink.gatts_peer_addr, BLE_MAX_TX_PDU_LEN);
+
+        // the controller falls back to 1M if the host does not support 2M
+        phy.tx_phys = phy.rx_phys = BTM_BLE_PREFER_1M_PHY | BTM_BLE_PREFER_2M_PHY;
+    }
+    else
+    {
+        WICED_BT_TRACE("\ntyping link profile");
+        hidd_blelink_conn_param_update();
+        phy.tx_phys = phy.rx_phys = BLE_typingPhys();
+    }
+
+    wiced_bt_ble_set_phy(&phy);
+}
+
+#ifdef CONN_EVT_ALIGN
+/********************************************************************************
+ * Function Name: wiced_bool_t ble_keyscanActivity(void)
+ ********************************************************************************
+ * Summary: Key activity between connection events. The poll callback runs just
+ *          ahead of each connection event the device wakes for, so the keys are
+ *          left to it and slave latency is cancelled to have the very next
+ *          event polled instead of waiting out the latency.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if the keys will be read at the next connection event
+ *
+ *******************************************************************************/
+wiced_bool_t ble_keyscanActivity(void)
+{
+    if (!ble.connected || !route_isTarget(BT_TRANSPORT_LE))
+    {
+        return FALSE;
+    }
+
+    if (!ble.latencyCancelled)
+    {
+        ble.latencyCancelled = TRUE;
+        wiced_blehidd_allow_slave_latency(FALSE);
+    }
+    return TRUE;
+}
+
+/********************************************************************************
+ * Function Name: void ble_pollActivity(uint8_t activity)
+ ********************************************************************************
+ * Summary: Allow slave latency again once the keys are released and the reports
+ *          are sent
+ *
+ * Parameters:
+ *  activity -- activity found in the poll
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ble_pollActivity(uint8_t activity)
+{
+    if (ble.latencyCancelled && activity == HIDLINK_ACTIVITY_NONE)
+    {
+        ble.latencyCancelled = FALSE;
+        wiced_blehidd_allow_slave_latency(TRUE);
+    }
+}
+#endif
+
+/********************************************************************************
+ * Function Name: ble_management_cback
+ ********************************************************************************
+ * Summary: Bluetooth management events of interest to the LE link, passed on by
+ *          the HID library before it handles them
+ *
+ * Parameters:
+ *  event -- management event
+ *  p_event_data -- event data
+ *
+ * Return:
+ *  WICED_BT_SUCCESS
+ *
+ *******************************************************************************/
+wiced_result_t ble_management_cback(wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data)
+{
+    switch (event) {
+    case BTM_BLE_PHY_UPDATE_EVT:
+        BLE_phyUpdated(&p_event_data->ble_phy_update_event);
+        break;
+
+    case BTM_BLE_DATA_LENGTH_UPDATE_EVENT:
+        BLE_dataLengthUpdated(&p_event_data->ble_data_length_update_event);
+        break;
+
+    case BTM_ENCRYPTION_STATUS_EVT:
+        // the stack reports the bonded identity address, not the private one on air
+        if ((p_event_data->encryption_status.transport == BT_TRANSPORT_LE) &&
+            (p_event_data->encryption_status.result == WICED_BT_SUCCESS))
+        {
+            BLE_linkIdentified(p_event_data->encryption_status.bd_addr);
+        }
+        break;
+
+    case BTM_BLE_ADVERT_STATE_CHANGED_EVT:
+        BLE_advertStateChanged(p_event_data->ble_advert_state_changed);
+        break;
+
+    default:
+        break;
+    }
+    return WICED_BT_SUCCESS;
 }
 
 /********************************************************************************
@@ -1442,6 +2317,49 @@ uint16_t ble_get_cccd_flag(CLIENT_CONFIG_NOTIF_T idx)
     return (idx < BLE_RPT_INDX_MAX) ? cccd[idx] : 0;
 }
 
+/********************************************************************************
+ * Function Name: wiced_bool_t ble_sendReport(uint8_t * rpt, uint16_t len)
+ ********************************************************************************
+ * Summary: Send an input report on the LE link, whichever link is active
+ *
+ * Parameters:
+ *  rpt -- report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+wiced_bool_t ble_sendReport(uint8_t * rpt, uint16_t len)
+{
+    uint8_t idx = report_index(WICED_HID_REPORT_TYPE_INPUT, rpt[0]);
+    uint16_t handle = BLE_reportHandle[idx];
+    uint8_t bitmap = report_table[idx].cccdBitmap;
+    uint8_t bit;
+
+    if (app.protocol != PROTOCOL_REPORT)
+    {
+        // boot mode carries the standard key report only
+        if (idx != RPT_IDX_STD_KEY)
+        {
+            return FALSE;
+        }
+        handle = HANDLE_APP_LE_HID_SERVICE_HID_BT_KB_INPUT_VAL;
+        bitmap = APP_CLIENT_CONFIG_NOTIF_BOOT_RPT;
+    }
+
+    for (bit = 0; bitmap > 1; bit++)
+    {
+        bitmap >>= 1;
+    }
+
+    if (!handle || !bitmap || !ble_is_notification_enabled(bit))
+    {
+        return FALSE;
+    }
+    return wiced_bt_gatt_send_notification(hidd_blelink.gatts_conn_id, handle, len - 1, &rpt[1]) == WICED_BT_GATT_SUCCESS;
+}
+
 /********************************************************************************
  * Function Name: ble_updateClientConfFlags
  ********************************************************************************
@@ -1479,7 +2397,7 @@ void ble_setProtocol(uint8_t newProtocol)
     if(newProtocol == PROTOCOL_REPORT)
     {
         // If the current protocol is report, register the report mode table
-        wiced_blehidd_register_report_table(reportModeGattMap, sizeof(reportModeGattMap)/sizeof(reportModeGattMap[0]));
+        wiced_blehidd_register_report_table(reportModeGattMap, reportModeGattMapSize);
     }
     else
     {
@@ -1502,8 +2420,10 @@ void ble_setProtocol(uint8_t newProtocol)
 void ble_init()
 {
     WICED_BT_TRACE("\nble_init");
+    BLE_buildReportModeGattMap();
+
     /*  LE GATT DB Initialization  */
-    hidd_gatts_init( reportModeGattMap, sizeof(reportModeGattMap)/sizeof(wiced_blehidd_report_gatt_characteristic_t),
+    hidd_gatts_init( reportModeGattMap, reportModeGattMapSize,
                      blehid_db_data, blehid_db_size,
                      blehid_gattAttributes, blehid_gattAttributes_size,
                      NULL, NULL );
@@ -39,7 +39,6 @@
 #ifndef __APP_BLE_H__
 #define __APP_BLE_H__
 
-#ifdef BLE_SUPPORT
 #include "wiced.h"
 
 /*****************************************************************************
@@ -54,11 +53,28 @@ typedef enum {
     APP_CLIENT_CONFIG_NOTIF_FUNC_LOCK_BIT,   // 4
     APP_CLIENT_CONFIG_NOTIF_BATTERY_BIT,     // 5
     APP_CLIENT_CONFIG_NOTIF_SCROLL_BIT,      // 6
+    APP_CLIENT_CONFIG_NOTIF_CONSUMER_BIT,    // 7
     BLE_RPT_INDX_MAX
 } CLIENT_CONFIG_NOTIF_e;
 
 typedef uint8_t CLIENT_CONFIG_NOTIF_T;
 
+/// LE time to reconnect statistics
+typedef struct {
+    uint16_t count;                     // reconnections
+    uint16_t directed;                  // reconnections made during the directed burst
+    uint16_t failed;                    // reconnections given up
+    uint32_t total_ms;                  // sum of the times to reconnect
+    uint32_t max_ms;
+    uint32_t last_ms;
+} ble_reconnect_stats_t;
+
+/// LE link profiles
+typedef enum {
+    BLE_LINK_PROFILE_TYPING,    // preferred connection parameters with slave latency
+    BLE_LINK_PROFILE_OTA,       // highest throughput for firmware upgrade
+} ble_link_profile_e;
+
 /*****************************************************************************
  * Define Client Config Notification Flags
  ****************************************************************************/
@@ -70,6 +86,11 @@ typedef uint8_t CLIENT_CONFIG_NOTIF_T;
 #define APP_CLIENT_CONFIG_NOTIF_FUNC_LOCK_RPT       (1<<APP_CLIENT_CONFIG_NOTIF_FUNC_LOCK_BIT )  // 0x010
 #define APP_CLIENT_CONFIG_NOTIF_BATTERY_RPT         (1<<APP_CLIENT_CONFIG_NOTIF_BATTERY_BIT   )  // 0x020
 #define APP_CLIENT_CONFIG_NOTIF_SCROLL_RPT          (1<<APP_CLIENT_CONFIG_NOTIF_SCROLL_BIT    )  // 0x040
+#define APP_CLIENT_CONFIG_NOTIF_CONSUMER_RPT        (1<<APP_CLIENT_CONFIG_NOTIF_CONSUMER_BIT  )  // 0x080
+
+#ifdef BLE_SUPPORT
+
+extern ble_reconnect_stats_t bleReconnectStats;
 
 /********************************************************************************
  * Function Name: uint16_t ble_get_cccd_flag(CLIENT_CONFIG_NOTIF_T idx)
@@ -113,6 +134,21 @@ uint16_t ble_get_cccd_flag(CLIENT_CONFIG_NOTIF_T idx);
  *******************************************************************************/
 #define ble_is_indication_enabled(idx) (ble_get_cccd_flag(idx) & GATT_CLIENT_CONFIG_INDICATION)
 
+/********************************************************************************
+ * Function Name: wiced_bool_t ble_sendReport(uint8_t * rpt, uint16_t len)
+ ********************************************************************************
+ * Summary: Send an input report on the LE link, whichever link is active
+ *
+ * Parameters:
+ *  rpt -- report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+wiced_bool_t ble_sendReport(uint8_t * rpt, uint16_t len);
+
 /********************************************************************************
  * Function Name: ble_updateClientConfFlags
  ********************************************************************************
@@ -144,6 +180,101 @@ void ble_updateClientConfFlags(uint16_t enable, uint16_t featureBit);
  *******************************************************************************/
 void ble_setProtocol(uint8_t newProtocol);
 
+/********************************************************************************
+ * Function Name: void ble_set_link_profile(uint8_t profile)
+ ********************************************************************************
+ * Summary: Switch the LE link between the typing profile and the OTA profile.
+ *          Each OTA profile request is released by a typing one, the link goes
+ *          back to typing when the last one is released.
+ *
+ * Parameters:
+ *  profile -- BLE_LINK_PROFILE_TYPING or BLE_LINK_PROFILE_OTA
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ble_set_link_profile(uint8_t profile);
+
+/********************************************************************************
+ * Function Name: ble_management_cback
+ ********************************************************************************
+ * Summary: Bluetooth management events of interest to the LE link
+ *
+ * Parameters:
+ *  event -- management event
+ *  p_event_data -- event data
+ *
+ * Return:
+ *  WICED_BT_SUCCESS
+ *
+ *******************************************************************************/
+wiced_result_t ble_management_cback(wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
+
+#ifdef CONN_EVT_ALIGN
+/********************************************************************************
+ * Function Name: wiced_bool_t ble_keyscanActivity(void)
+ ********************************************************************************
+ * Summary: Key activity between connection events. Cancels slave latency so the
+ *          keys are read and reported at the next connection event.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if the keys will be read at the next connection event
+ *
+ *******************************************************************************/
+wiced_bool_t ble_keyscanActivity(void);
+
+/********************************************************************************
+ * Function Name: void ble_pollActivity(uint8_t activity)
+ ********************************************************************************
+ * Summary: Allow slave latency again once the keys are quiet
+ *
+ * Parameters:
+ *  activity -- activity found in the poll
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ble_pollActivity(uint8_t activity);
+#else
+# define ble_keyscanActivity() FALSE
+# define ble_pollActivity(a)
+#endif
+
+/********************************************************************************
+ * Function Name: void ble_statsSave(void)
+ ********************************************************************************
+ * Summary: Write the link records and the reconnect statistics to the journal
+ *          if they changed
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ble_statsSave(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t ble_statsReadyForSleep(void)
+ ********************************************************************************
+ * Summary: Check the link records and reconnect statistics before deep sleep.
+ *          Unsaved ones are queued to be saved from the application thread.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if nothing is left to save
+ *
+ *******************************************************************************/
+wiced_bool_t ble_statsReadyForSleep(void);
+
 /********************************************************************************
  * Function Name: void ble_init()
  ********************************************************************************
@@ -161,6 +292,13 @@ void ble_init();
 #else  // !BLE_SUPPORT
 # define ble_init()
 # define ble_setProtocol(p)
+# define ble_set_link_profile(p)
+# define ble_management_cback NULL
+# define ble_sendReport(r,l) FALSE
+# define ble_statsSave()
+# define ble_statsReadyForSleep() TRUE
+# define ble_keyscanActivity() FALSE
+# define ble_pollActivity(a)
 #endif // BLE_SUPPORT
 
 #endif // __APP_BLE_H__
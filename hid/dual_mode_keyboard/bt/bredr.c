@@ -40,16 +40,22 @@
 #include "app.h"
 #include "wiced_bt_dev.h"
 #include "wiced_bt_sdp.h"
+#include "wiced_bt_hidd.h"
 
 ///////////////////////////////////////////////////////////////////////////////////
 // BR/EDR Link related defines
 ///////////////////////////////////////////////////////////////////////////////////
 #define LINK_SUPERVISION_TIMEOUT_IN_SLOTS   3200
+#define SSR_HOST_MAX_LAT_IN_SLOTS           792
 
 // Use this to find out the value of SPD_RPT_DESCRIPTOR_SIZE, if the value is over 255, need to use two-byte field instead
 //char data[] = {USB_RPT_DESCRIPTOR};
 // WICED_BT_TRACE("\nSize of SPD_RPT_DESCRIPTOR_SIZE is %d", sizeof(data));  -- located in bredr_init()
-#define SPD_RPT_DESCRIPTOR_SIZE 255
+#ifdef SUPPORT_KEY_STATS
+ #define SPD_RPT_DESCRIPTOR_SIZE 303     // KEY_STATS_REPORT_DESCRIPTOR adds 23 bytes
+#else
+ #define SPD_RPT_DESCRIPTOR_SIZE 280
+#endif
 
 /*****************************************************************************
  * This is the SDP database for the BT HID KB application.
@@ -109,7 +115,7 @@ static const UINT8 wiced_bt_sdp_db[] =
     SDP_ATTR_UINT2(ATTR_ID_HID_LINK_SUPERVISION_TO, LINK_SUPERVISION_TIMEOUT_IN_SLOTS),  // 6 bytes==>0x9, 0x02, 0x0C, 0x9, 0x0C, 0x80 (0xC80=3200 slots = 2 seconds)
     SDP_ATTR_BOOLEAN(ATTR_ID_HID_NORMALLY_CONNECTABLE, HID_DEV_NORMALLY_CONN),           // 5 bytes==>0x9, 0x02, 0x0D, 0x28, 0x0(FALSE)
     SDP_ATTR_BOOLEAN(ATTR_ID_HID_BOOT_DEVICE, 0x01),                    // 5 bytes==>0x9, 0x02, 0x0E, 0x28, 0x1(TRUE)
-    SDP_ATTR_UINT2(ATTR_ID_HID_SSR_HOST_MAX_LAT, 792),                  // 6 bytes==>0x9, 0x02, 0x0F, 0x9, 0x03, 0x18 (0xC80=792 slots = 495 mS)
+    SDP_ATTR_UINT2(ATTR_ID_HID_SSR_HOST_MAX_LAT, SSR_HOST_MAX_LAT_IN_SLOTS),  // 6 bytes==>0x9, 0x02, 0x0F, 0x9, 0x03, 0x18 (0xC80=792 slots = 495 mS)
     SDP_ATTR_UINT2(ATTR_ID_HID_SSR_HOST_MIN_TOUT, 0),                   // 6 bytes==>0x9, 0x02, 0x10, 0x9, 0x0, 0x0 (recommend 0x00 for this value)
 
     // Second SDP record Device ID
@@ -137,74 +143,284 @@ static const UINT8 wiced_bt_sdp_db[] =
 };
 //const uint16_t wiced_bt_sdp_db_size = (sizeof(wiced_bt_sdp_db));
 
-#if !is_208xxFamily     // power management patch is not in 208xx
+#ifdef SUPPORT_BREDR_SNIFF
 /*****************************************************************************
- * BT HID power management states configuration
+ * BT HID power management states
+ *
+ * The link stays active for a while after connection, then goes to sniff for
+ * typing. When no key is pressed for a while the sniff subrating latency is
+ * raised up to the SSR host max latency published in the SDP record. A key
+ * press brings the latency back down.
  ****************************************************************************/
-static wiced_bt_hidd_pm_pwr_state_t bthid_powerStateList[] =
+#define BREDR_PM_FOLD_MS            3600000     // fold the idle time once an hour, well within the BT clock wrap
+#define BREDR_PM_TIMEOUT(s)         (bthid_powerStateList[s].timeoutToNextInMs ? bthid_powerStateList[s].timeoutToNextInMs : BREDR_PM_FOLD_MS)
+
+typedef struct
 {
+    uint16_t sniffMin;              // slots, 0 to stay active
+    uint16_t sniffMax;              // slots
+    uint16_t attempt;
+    uint16_t timeout;
+    uint16_t ssrMaxLatency;         // slots, 0 for no subrating
+    uint32_t timeoutToNextInMs;     // no activity time before going to the next state, 0 to stay
+} bredr_pm_state_t;
+
+static const bredr_pm_state_t bthid_powerStateList[BREDR_PM_STATE_MAX] =
+{
+    // BREDR_PM_ACTIVE, time for encryption and host setup after connection
     {
-        POWER_MODE_HIGH,            // mode
-        0,                          // maxNegotiationAttempts 0= infinite
-        60000,                      // timeoutToNextInMs. 60s in this state
-        SNIFF_NORMAL,               // type
-        1,                         // asymmetricMultiplier
-        {
-            36,                     // 36 slots
-            36,                     // 36 slots
-            1,                      // 1 attempt
-            1                       // 0 timeout
-        }
-    },
-    {
-        POWER_MODE_DISCONNECT,      // BtLowPowerMode
+        0,                          // active
+        0,                          // dont care
         0,                          // dont care
         0,                          // dont care
-        SNIFF_NORMAL,               // dont care
-        1,                           // dont care
+        0,                          // dont care
+        5000,                       // 5s in this state
+    },
+    // BREDR_PM_TYPING
+    {
+        18,                         // 18 slots, 11.25 ms
+        36,                         // 36 slots, 22.5 ms
+        1,                          // 1 attempt
+        1,                          // 1 timeout
+        0,                          // no subrating
+        10000,                      // 10s without key press
+    },
+    // BREDR_PM_IDLE
+    {
+        18,                         // same sniff as typing, so only subrating changes
+        36,
+        1,
+        1,
+        SSR_HOST_MAX_LAT_IN_SLOTS,  // 792 slots, 495 ms
+        0,                          // stay
+    },
+};
+
+static struct {
+    wiced_bool_t              connected;
+    uint8_t                   state;
+    wiced_bt_device_address_t bdAddr;                           // BR/EDR host
+    wiced_timer_t             timer;
+    uint32_t                  stateStartBtClk;
+    uint32_t                  activityBtClk;                    // last key activity
+    uint32_t                  timeInState_ms[BREDR_PM_STATE_MAX];
+    uint16_t                  transitions;
+} bredr_pm;
+
+/********************************************************************************
+ * Function Name: BREDR_pmFold
+ ********************************************************************************
+ * Summary: add the time spent in the current state to its counter
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BREDR_pmFold(void)
+{
+    if (bredr_pm.connected)
+    {
+        bredr_pm.timeInState_ms[bredr_pm.state] += BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(bredr_pm.stateStartBtClk));
+        bredr_pm.stateStartBtClk = wiced_hidd_get_current_native_bt_clocks();
+    }
+}
+
+/********************************************************************************
+ * Function Name: BREDR_pmEnter
+ ********************************************************************************
+ * Summary: request the link power mode of a state and arm its timer
+ *
+ * Parameters:
+ *  state -- bredr_pm_state_e
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BREDR_pmEnter(uint8_t state)
+{
+    const bredr_pm_state_t * pm = &bthid_powerStateList[state];
+    wiced_bt_dev_status_t status = WICED_BT_SUCCESS;
+
+    if (pm->sniffMin)
+    {
+        status = wiced_bt_dev_set_sniff_subrating(bredr_pm.bdAddr, pm->ssrMaxLatency, 0, 0);
+
+        // typing and idle share the sniff interval, between them only the subrating
+        // is renegotiated and the link stays in sniff
+        if ((bredr_pm.state == BREDR_PM_ACTIVE) && (status == WICED_BT_SUCCESS || status == WICED_BT_PENDING))
         {
-            0,                       // dont care
-            0,                       // dont care
-            0,                       // dont care
-            0                        // dont care
+            status = wiced_bt_dev_set_sniff_mode(bredr_pm.bdAddr, pm->sniffMin, pm->sniffMax, pm->attempt, pm->timeout);
         }
     }
-};
-#endif
 
-/*****************************************************************************
- * BT HID power management states configuration used when sniff subrate (SSR) is enabled by host
- ****************************************************************************/
-static wiced_bt_hidd_pm_pwr_state_t bthid_SSRPowerStatesList[] =
+    if (status != WICED_BT_SUCCESS && status != WICED_BT_PENDING)
+    {
+        // host won't take it now, try again after the current state timeout
+        WICED_BT_TRACE("\nsniff request failed %d", status);
+        wiced_start_timer(&bredr_pm.timer, BREDR_PM_TIMEOUT(bredr_pm.state));
+        return;
+    }
+
+    BREDR_pmFold();
+    if (bredr_pm.state != state)
+    {
+        bredr_pm.state = state;
+        bredr_pm.transitions++;
+    }
+    wiced_start_timer(&bredr_pm.timer, BREDR_PM_TIMEOUT(state));
+}
+
+/********************************************************************************
+ * Function Name: BREDR_pmTimeout
+ ********************************************************************************
+ * Summary: state timer expired, move to the next state if there was no activity
+ *
+ * Parameters:
+ *  arg -- not used
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BREDR_pmTimeout(uint32_t arg)
 {
+    uint32_t timeout = bthid_powerStateList[bredr_pm.state].timeoutToNextInMs;
+    uint32_t quiet_ms = BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(bredr_pm.activityBtClk));
+
+    if (!bredr_pm.connected)
     {
-        POWER_MODE_IDLE,
-        0,
-        60000,                           // Next state after 60s
-        SNIFF_NORMAL,
-        1,
+        return;
+    }
+
+    switch (bredr_pm.state) {
+    case BREDR_PM_ACTIVE:
+        BREDR_pmEnter(BREDR_PM_TYPING);
+        break;
+
+    case BREDR_PM_TYPING:
+        if (quiet_ms < timeout)
         {
-            36,                      // dont care
-            36,                      // dont care
-            1,                       // dont care
-            0                        // dont care
+            // keys were pressed, wait for the rest of the quiet time
+            wiced_start_timer(&bredr_pm.timer, timeout - quiet_ms);
         }
-    },
+        else
+        {
+            BREDR_pmEnter(BREDR_PM_IDLE);
+        }
+        break;
+
+    default:
+        // keep the idle time counter from wrapping with the BT clock
+        BREDR_pmFold();
+        wiced_start_timer(&bredr_pm.timer, BREDR_PM_FOLD_MS);
+        break;
+    }
+}
+
+/********************************************************************************
+ * Function Name: BREDR_pmLinkStateChange
+ ********************************************************************************
+ * Summary: start the power states on connection, stop them on disconnection
+ *
+ * Parameters:
+ *  newState -- new link state
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void BREDR_pmLinkStateChange(uint8_t newState)
+{
+    wiced_bool_t connected = (newState & HIDLINK_MASK) == HIDLINK_CONNECTED;
+
+    if (connected == bredr_pm.connected)
+    {
+        return;
+    }
+
+    if (connected)
     {
-        POWER_MODE_DISCONNECT,       // PowerMode
-        0,                           // dont care
-        0,                           // dont care
-        SNIFF_NORMAL,                // dont care
-        1,                           // dont care
+        // the host connecting is the current host
+        memcpy(bredr_pm.bdAddr, hidd_host_addr(), BD_ADDR_LEN);
+        bredr_pm.connected = TRUE;
+        bredr_pm.state = BREDR_PM_ACTIVE;
+        bredr_pm.stateStartBtClk = bredr_pm.activityBtClk = wiced_hidd_get_current_native_bt_clocks();
+        wiced_start_timer(&bredr_pm.timer, BREDR_PM_TIMEOUT(BREDR_PM_ACTIVE));
+    }
+    else
+    {
+        wiced_stop_timer(&bredr_pm.timer);
+        BREDR_pmFold();
+        bredr_pm.connected = FALSE;
+        WICED_BT_TRACE("\nBR/EDR pm active:%d typing:%d idle:%d ms, %d transitions",
+                        bredr_pm.timeInState_ms[BREDR_PM_ACTIVE], bredr_pm.timeInState_ms[BREDR_PM_TYPING],
+                        bredr_pm.timeInState_ms[BREDR_PM_IDLE], bredr_pm.transitions);
+    }
+}
+
+/********************************************************************************
+ * Function Name: void bredr_pmActivity()
+ ********************************************************************************
+ * Summary: key activity, bring the link latency down for typing
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bredr_pmActivity(void)
+{
+    if (bredr_pm.connected)
+    {
+        bredr_pm.activityBtClk = wiced_hidd_get_current_native_bt_clocks();
+        if (bredr_pm.state == BREDR_PM_IDLE)
         {
-            0,                       // dont care
-            0,                       // dont care
-            0,                       // dont care
-            0                        // dont care
+            BREDR_pmEnter(BREDR_PM_TYPING);
         }
     }
-};
-//const uint8_t bthid_SSRPowerStatesList_num = sizeof(bthid_SSRPowerStatesList)/sizeof(wiced_bt_hidd_pm_pwr_state_t);
+}
+
+/********************************************************************************
+ * Function Name: uint32_t bredr_pmTimeInState(uint8_t state)
+ ********************************************************************************
+ * Summary: time the BR/EDR link has spent in a power state since power up
+ *
+ * Parameters:
+ *  state -- bredr_pm_state_e
+ *
+ * Return:
+ *  time in ms
+ *
+ *******************************************************************************/
+uint32_t bredr_pmTimeInState(uint8_t state)
+{
+    BREDR_pmFold();
+    return state < BREDR_PM_STATE_MAX ? bredr_pm.timeInState_ms[state] : 0;
+}
+
+/********************************************************************************
+ * Function Name: uint16_t bredr_pmTransitions(void)
+ ********************************************************************************
+ * Summary: number of BR/EDR power state changes since power up
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  state changes
+ *
+ *******************************************************************************/
+uint16_t bredr_pmTransitions(void)
+{
+    return bredr_pm.transitions;
+}
+#endif
 
 /********************************************************************************
  * Function Name: void BREDR_write_eir
@@ -264,6 +480,9 @@ STATIC void BREDR_write_eir(const char * dev_name)
  *******************************************************************************/
 STATIC void BREDR_transportStateChangeNotification(uint32_t newState)
 {
+#ifdef SUPPORT_BREDR_SNIFF
+    BREDR_pmLinkStateChange((uint8_t) newState);
+#endif
     app_transportStateChangeNotification(BT_TRANSPORT_BR_EDR, (uint8_t) newState);
 }
 
@@ -289,12 +508,10 @@ void bredr_init()
     //Use this to find out the value of SPD_RPT_DESCRIPTOR_SIZE for the define
     //WICED_BT_TRACE("\nSize of SPD_RPT_DESCRIPTOR_SIZE is %d", sizeof(data));
 
-// #if !is_208xxFamily     // power management patch is not in 208xx
- #if 0 // need to work on 20735 wiced_bt_hidd_configure_power_management_params() access
-    /* BT HID power management configuration  */
-    wiced_bt_hidd_configure_power_management_params(bthid_powerStateList, sizeof(bthid_powerStateList)/sizeof(wiced_bt_hidd_pm_pwr_state_t),
-                                               bthid_SSRPowerStatesList, sizeof(bthid_SSRPowerStatesList)/sizeof(wiced_bt_hidd_pm_pwr_state_t));
- #endif
+#ifdef SUPPORT_BREDR_SNIFF
+    /* BT HID power management, done by the app as the hidd power state lists are not accessible */
+    wiced_init_timer(&bredr_pm.timer, BREDR_pmTimeout, 0, WICED_MILLI_SECONDS_TIMER);
+#endif
 
     /* initialize eir */
     BREDR_write_eir(BT_LOCAL_NAME);
@@ -302,4 +519,23 @@ void bredr_init()
     hidd_btlink_add_state_observer(BREDR_transportStateChangeNotification);
 
 }
+
+/********************************************************************************
+ * Function Name: wiced_bool_t bredr_sendReport(uint8_t * rpt, uint16_t len)
+ ********************************************************************************
+ * Summary: Send an input report on the BR/EDR interrupt channel, whichever link
+ *          is active
+ *
+ * Parameters:
+ *  rpt -- report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+wiced_bool_t bredr_sendReport(uint8_t * rpt, uint16_t len)
+{
+    return wiced_bt_hidd_send_data(WICED_FALSE, HID_PAR_REP_TYPE_INPUT, rpt, len) == WICED_BT_HIDD_SUCCESS;
+}
 #endif
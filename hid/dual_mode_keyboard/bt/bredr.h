@@ -39,6 +39,14 @@
 #ifndef __APP_BREDR_H__
 #define __APP_BREDR_H__
 
+/// BR/EDR link power states
+typedef enum {
+    BREDR_PM_ACTIVE,        // no sniff, right after connection
+    BREDR_PM_TYPING,        // short sniff interval
+    BREDR_PM_IDLE,          // sniff subrating up to the SSR host max latency
+    BREDR_PM_STATE_MAX
+} bredr_pm_state_e;
+
 #ifdef BR_EDR_SUPPORT
 
 /********************************************************************************
@@ -55,8 +63,76 @@
  *******************************************************************************/
 void bredr_init();
 
+/********************************************************************************
+ * Function Name: wiced_bool_t bredr_sendReport(uint8_t * rpt, uint16_t len)
+ ********************************************************************************
+ * Summary: Send an input report on the BR/EDR interrupt channel, whichever link
+ *          is active
+ *
+ * Parameters:
+ *  rpt -- report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+wiced_bool_t bredr_sendReport(uint8_t * rpt, uint16_t len);
+
+#ifdef SUPPORT_BREDR_SNIFF
+/********************************************************************************
+ * Function Name: void bredr_pmActivity()
+ ********************************************************************************
+ * Summary: key activity, bring the link latency down for typing
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void bredr_pmActivity(void);
+
+/********************************************************************************
+ * Function Name: uint32_t bredr_pmTimeInState(uint8_t state)
+ ********************************************************************************
+ * Summary: time the BR/EDR link has spent in a power state since power up
+ *
+ * Parameters:
+ *  state -- bredr_pm_state_e
+ *
+ * Return:
+ *  time in ms
+ *
+ *******************************************************************************/
+uint32_t bredr_pmTimeInState(uint8_t state);
+
+/********************************************************************************
+ * Function Name: uint16_t bredr_pmTransitions(void)
+ ********************************************************************************
+ * Summary: number of BR/EDR power state changes since power up
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  state changes
+ *
+ *******************************************************************************/
+uint16_t bredr_pmTransitions(void);
+#else
+# define bredr_pmActivity()
+# define bredr_pmTimeInState(s) 0
+# define bredr_pmTransitions() 0
+#endif
+
 #else  // !BLE_SUPPORT
 # define bredr_init()
+# define bredr_sendReport(r,l) FALSE
+# define bredr_pmActivity()
+# define bredr_pmTimeInState(s) 0
+# define bredr_pmTransitions() 0
 #endif // BLE_SUPPORT
 
 #endif // __APP_BREDR_H__
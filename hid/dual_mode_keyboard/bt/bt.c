@@ -52,7 +52,11 @@ wiced_bt_cfg_settings_t bt_cfg =
     .device_class                        = {0x04, 0x05, 0x00},                               /**< Local device class */
     .security_requirement_mask           = BTM_SEC_ENCRYPT,                                  /**< Security requirements mask (BTM_SEC_NONE, or combinination of BTM_SEC_IN_AUTHENTICATE, BTM_SEC_OUT_AUTHENTICATE, BTM_SEC_ENCRYPT (see #wiced_bt_sec_level_e)) */
 
+#ifdef SUPPORT_DUAL_HOST
+    .max_simultaneous_links              = 2,                                                /**< one LE host and one BR/EDR host */
+#else
     .max_simultaneous_links              = 1,                                                /**< Maximum number simultaneous links to different devices */
+#endif
 
     .br_edr_scan_cfg = /* BR/EDR scan config */
     {
@@ -41,6 +41,7 @@
 
 #include "ble.h"
 #include "bredr.h"
+#include "route.h"
 
 extern wiced_bt_cfg_settings_t bt_cfg;
 extern uint8_t rpt_descriptor_db[];
@@ -137,6 +138,29 @@ extern uint8_t rpt_descriptor_db[];
 #define USAGE_RESERVED2     0x0A, 0x02, 0xFF
 #define USAGE_RESERVED3     0x0A, 0x03, 0xFF
 
+// 16-bit values of the consumer page usages above, used in the consumer control report
+#define CC_USAGE_POWER          0x0030
+#define CC_USAGE_FUNCTION       0x0036
+#define CC_USAGE_MENU           0x0040
+#define CC_USAGE_PLAY           0x00B0
+#define CC_USAGE_PAUSE          0x00B1
+#define CC_USAGE_FAST_FORWRD    0x00B3
+#define CC_USAGE_REWIND         0x00B4
+#define CC_USAGE_NEXT_TRACK     0x00B5
+#define CC_USAGE_PREV_TRACK     0x00B6
+#define CC_USAGE_PLAY_PAUSE     0x00CD
+#define CC_USAGE_MUTE           0x00E2
+#define CC_USAGE_VOL_UP         0x00E9
+#define CC_USAGE_VOL_DOWN       0x00EA
+#define CC_USAGE_INTERNET       0x0196
+#define CC_USAGE_LOCK_SCRSVR    0x019E
+#define CC_USAGE_AC_COPY        0x021B
+#define CC_USAGE_AC_SEARCH      0x0221
+#define CC_USAGE_AC_HOME        0x0223
+#define CC_USAGE_AC_BACK        0x0224
+#define CC_USAGE_AC_EDIT        0x023D
+#define CC_USAGE_MAX            0x03FF
+
 #define BITMAPPED_REPORT_DESCRIPTOR \
     /* Bit mapped report, RPT_ID_IN_BIT_MAPPED */ \
     0x05, 0x0C,                    /* USAGE_PAGE (Consumer Devices) */ \
@@ -226,6 +250,39 @@ extern uint8_t rpt_descriptor_db[];
     0x81, 0x03,                    /*    INPUT (Cnst,Var,Abs) */ \
     0xc0,                          /*  END_COLLECTION */
 
+// Consumer control report, RPT_ID_IN_CONSUMER. Array of 16-bit usages
+#define CONSUMER_REPORT_DESCRIPTOR \
+    0x05, 0x0C,                    /* USAGE_PAGE (Consumer Devices) */ \
+    0x09, 0x01,                    /* USAGE (Consumer Control) */ \
+    0xA1, 0x01,                    /* COLLECTION (Application) */ \
+    0x85, RPT_ID_IN_CONSUMER,      /*    REPORT_ID (8) */ \
+    0x15, 0x00,                    /*    LOGICAL_MINIMUM (0) */ \
+    0x26, 0xFF, 0x03,              /*    LOGICAL_MAXIMUM (0x3FF) */ \
+    0x19, 0x00,                    /*    USAGE_MINIMUM (0) */ \
+    0x2A, 0xFF, 0x03,              /*    USAGE_MAXIMUM (0x3FF) */ \
+    0x75, 0x10,                    /*    REPORT_SIZE (16) */ \
+    0x95, KEY_NUM_USAGES_IN_CONSUMER_REPORT, /* REPORT_COUNT */ \
+    0x81, 0x00,                    /*    INPUT (Data,Ary,Abs) */ \
+    0xC0,                          /* END_COLLECTION */
+
+#ifdef SUPPORT_KEY_STATS
+// Key statistics feature report, RPT_ID_FEATURE_KEY_STATS. Vendor defined
+#define KEY_STATS_REPORT_DESCRIPTOR \
+    0x06, 0x00, 0xFF,              /* USAGE_PAGE (Vendor Defined 0xFF00) */ \
+    0x09, 0x01,                    /* USAGE (1) */ \
+    0xA1, 0x01,                    /* COLLECTION (Application) */ \
+    0x85, RPT_ID_FEATURE_KEY_STATS,/*    REPORT_ID (0xcd) */ \
+    0x09, 0x02,                    /*    USAGE (2) */ \
+    0x15, 0x00,                    /*    LOGICAL_MINIMUM (0) */ \
+    0x26, 0xFF, 0x00,              /*    LOGICAL_MAXIMUM (255) */ \
+    0x75, 0x08,                    /*    REPORT_SIZE (8) */ \
+    0x95, KEY_STATS_RPT_SIZE,      /*    REPORT_COUNT */ \
+    0xB1, 0x02,                    /*    FEATURE (Data,Var,Abs) */ \
+    0xC0,                          /* END_COLLECTION */
+#else
+#define KEY_STATS_REPORT_DESCRIPTOR
+#endif
+
 // Use BATTERY_REPORT_DESCRIPTOR fo/r the last entry because it has no ',' in the end
 #define BATTERY_REPORT_DESCRIPTOR \
     /*Battery report */ \
@@ -252,6 +309,8 @@ extern uint8_t rpt_descriptor_db[];
   SLEEP_REPORT_DESCRIPTOR \
   FUNC_LOCK_REPORT_DESCRIPTOR \
   SCROLL_REPORT_DESCRIPTOR \
+  CONSUMER_REPORT_DESCRIPTOR \
+  KEY_STATS_REPORT_DESCRIPTOR \
   BATTERY_REPORT_DESCRIPTOR
 
 /********************************************************************************
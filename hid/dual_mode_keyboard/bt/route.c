@@ -0,0 +1,446 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Report routing between the LE and BR/EDR hosts
+ *
+ * Each link keeps a copy of the last input reports sent on it. When the
+ * reports are switched to the other link, the reports still holding keys on
+ * the old link are sent again cleared, and the current reports the new link
+ * has not seen yet are sent to it. Each link is flow controlled on its own
+ * buffers.
+ *
+ * Without DUAL_HOST, the one link hidd_link keeps up has its copy as well, so
+ * a report the host already has is not sent again.
+ *
+ */
+
+#include "app.h"
+
+#ifdef SUPPORT_DUAL_HOST
+
+#define ROUTE_LINKS                 2
+#define ROUTE_LINK(t)               ((t) == BT_TRANSPORT_LE ? 0 : 1)
+#define ROUTE_RPT_SIZE              RPT_INPUT_MAX_SIZE  // largest report kept per link
+
+static struct {
+    uint8_t  connected;                                     // bit per link
+    uint8_t  target;                                        // transport the reports go to
+    uint8_t  sent[ROUTE_LINKS][RPT_IDX_MAX][ROUTE_RPT_SIZE];// last input report sent on each link
+} route = {
+    .target = BT_TRANSPORT_LE,
+};
+
+/********************************************************************************
+ * Function Name: ROUTE_send
+ ********************************************************************************
+ * Summary: send an input report on a link and keep a copy of it
+ *
+ * Parameters:
+ *  transport -- link
+ *  ptr -- report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+STATIC wiced_bool_t ROUTE_send(uint8_t transport, uint8_t * ptr, uint16_t len)
+{
+    uint8_t idx = report_index(WICED_HID_REPORT_TYPE_INPUT, ptr[0]);
+    wiced_bool_t sent;
+
+    sent = (transport == BT_TRANSPORT_LE) ? ble_sendReport(ptr, len) : bredr_sendReport(ptr, len);
+    if (sent && (idx != RPT_IDX_NONE))
+    {
+        memcpy(route.sent[ROUTE_LINK(transport)][idx], ptr, len);
+    }
+    return sent;
+}
+
+/********************************************************************************
+ * Function Name: ROUTE_release
+ ********************************************************************************
+ * Summary: clear the reports that still hold keys on a link
+ *
+ * Parameters:
+ *  transport -- link
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void ROUTE_release(uint8_t transport)
+{
+    uint8_t rpt[ROUTE_RPT_SIZE];
+    uint8_t * sent;
+    uint8_t idx, size;
+
+    for (idx = RPT_IDX_NONE + 1; idx < RPT_IDX_MAX; idx++)
+    {
+        size = report_table[idx].size;
+        sent = route.sent[ROUTE_LINK(transport)][idx];
+
+        // the battery level is not a key
+        if ((report_table[idx].type == WICED_HID_REPORT_TYPE_INPUT) && (idx != RPT_IDX_BATTERY))
+        {
+            memset(rpt, 0, size);
+            rpt[0] = report_table[idx].id;
+            if (memcmp(sent, rpt, size))
+            {
+                ROUTE_send(transport, rpt, size);
+            }
+        }
+    }
+}
+
+/********************************************************************************
+ * Function Name: ROUTE_sync
+ ********************************************************************************
+ * Summary: send the current input reports a link has not seen yet
+ *
+ * Parameters:
+ *  transport -- link
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void ROUTE_sync(uint8_t transport)
+{
+    const report_entry_t * rpt;
+    uint8_t idx;
+
+    for (idx = RPT_IDX_NONE + 1; idx < RPT_IDX_MAX; idx++)
+    {
+        rpt = &report_table[idx];
+        if ((rpt->type == WICED_HID_REPORT_TYPE_INPUT) && rpt->data &&
+            memcmp(route.sent[ROUTE_LINK(transport)][idx], rpt->data, rpt->size))
+        {
+            ROUTE_send(transport, rpt->data, rpt->size);
+        }
+    }
+}
+
+/********************************************************************************
+ * Function Name: void route_linkStateChange(uint8_t transport, uint8_t newState)
+ ********************************************************************************
+ * Summary: Track the state of each link
+ *
+ * Parameters:
+ *  transport -- BT_TRANSPORT_LE or BT_TRANSPORT_BR_EDR
+ *  newState -- new link state
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void route_linkStateChange(uint8_t transport, uint8_t newState)
+{
+    uint8_t link = ROUTE_LINK(transport);
+    uint8_t other = (transport == BT_TRANSPORT_LE) ? BT_TRANSPORT_BR_EDR : BT_TRANSPORT_LE;
+    uint8_t idx;
+
+    switch (newState & HIDLINK_MASK) {
+    case HIDLINK_CONNECTED:
+        // a new host has no key down
+        memset(route.sent[link], 0, sizeof(route.sent[link]));
+        for (idx = RPT_IDX_NONE + 1; idx < RPT_IDX_MAX; idx++)
+        {
+            route.sent[link][idx][0] = report_table[idx].id;
+        }
+        route.connected |= 1 << link;
+        if (!(route.connected & (1 << ROUTE_LINK(route.target))))
+        {
+            route.target = transport;
+        }
+        break;
+
+    case HIDLINK_DISCONNECTED:
+        route.connected &= ~(1 << link);
+        if ((route.target == transport) && (route.connected & (1 << ROUTE_LINK(other))))
+        {
+            WICED_BT_TRACE("\nroute: %s link lost, reports go to %s", transport == BT_TRANSPORT_LE ? "LE" : "BR/EDR", other == BT_TRANSPORT_LE ? "LE" : "BR/EDR");
+            route.target = other;
+            ROUTE_sync(other);
+        }
+        break;
+    }
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_select(uint8_t transport)
+ ********************************************************************************
+ * Summary: Route the input reports to the host on the transport
+ *
+ * Parameters:
+ *  transport -- BT_TRANSPORT_LE or BT_TRANSPORT_BR_EDR
+ *
+ * Return:
+ *  TRUE if the reports now go to that link
+ *
+ *******************************************************************************/
+wiced_bool_t route_select(uint8_t transport)
+{
+    if (!(route.connected & (1 << ROUTE_LINK(transport))))
+    {
+        return FALSE;
+    }
+
+    if (route.target != transport)
+    {
+        WICED_BT_TRACE("\nroute: reports go to %s", transport == BT_TRANSPORT_LE ? "LE" : "BR/EDR");
+        ROUTE_release(route.target);
+        route.target = transport;
+        ROUTE_sync(transport);
+    }
+    return TRUE;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_sendReport(void * ptr, uint16_t len)
+ ********************************************************************************
+ * Summary: Send an input report on the selected link
+ *
+ * Parameters:
+ *  ptr -- pointer to the report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+wiced_bool_t route_sendReport(void * ptr, uint16_t len)
+{
+    if (route.connected & (1 << ROUTE_LINK(route.target)))
+    {
+        return ROUTE_send(route.target, ptr, len);
+    }
+    return FALSE;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_isRepeat(void * ptr, uint16_t len)
+ ********************************************************************************
+ * Summary: Check if an input report is the last one sent on the selected link
+ *
+ * Parameters:
+ *  ptr -- pointer to the report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the host already has this report
+ *
+ *******************************************************************************/
+wiced_bool_t route_isRepeat(void * ptr, uint16_t len)
+{
+    uint8_t idx = report_index(WICED_HID_REPORT_TYPE_INPUT, *(uint8_t *)ptr);
+
+    return (idx != RPT_IDX_NONE) && !memcmp(route.sent[ROUTE_LINK(route.target)][idx], ptr, len);
+}
+
+/********************************************************************************
+ * Function Name: void route_forgetSent(void)
+ ********************************************************************************
+ * Summary: Forget the reports sent on the selected link
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void route_forgetSent(void)
+{
+    // report ID 0 never matches, the next switch releases every report again
+    memset(route.sent[ROUTE_LINK(route.target)], 0, sizeof(route.sent[0]));
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_isConnected(void)
+ ********************************************************************************
+ * Summary: Check if the selected link is connected
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if connected
+ *
+ *******************************************************************************/
+wiced_bool_t route_isConnected(void)
+{
+    return (route.connected & (1 << ROUTE_LINK(route.target))) != 0;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_isTarget(uint8_t transport)
+ ********************************************************************************
+ * Summary: Check if the input reports go to the host on the transport
+ *
+ * Parameters:
+ *  transport -- BT_TRANSPORT_LE or BT_TRANSPORT_BR_EDR
+ *
+ * Return:
+ *  TRUE if the transport is the selected link
+ *
+ *******************************************************************************/
+wiced_bool_t route_isTarget(uint8_t transport)
+{
+    return route.target == transport;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_txReady(void)
+ ********************************************************************************
+ * Summary: Check if the selected link can take another report. LE reports
+ *          use the LE controller buffers, BR/EDR reports the ACL pool.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if there is room for a report
+ *
+ *******************************************************************************/
+wiced_bool_t route_txReady(void)
+{
+    if (route.target == BT_TRANSPORT_LE)
+    {
+        return wiced_bt_ble_get_available_tx_buffers() > 1;
+    }
+    return wiced_bt_buffer_poolutilization(HCI_ACL_POOL_ID) < 80;
+}
+
+#else // !SUPPORT_DUAL_HOST
+
+// one link at a time, hidd_link picks it
+static uint8_t route_sent[RPT_IDX_MAX][RPT_INPUT_MAX_SIZE];    // last input report sent on the link
+
+/********************************************************************************
+ * Function Name: void route_linkStateChange(uint8_t transport, uint8_t newState)
+ ********************************************************************************
+ * Summary: Forget the reports sent to the previous host when a link comes up
+ *
+ * Parameters:
+ *  transport -- BT_TRANSPORT_LE or BT_TRANSPORT_BR_EDR
+ *  newState -- new link state
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void route_linkStateChange(uint8_t transport, uint8_t newState)
+{
+    uint8_t idx;
+
+    if ((newState & HIDLINK_MASK) == HIDLINK_CONNECTED)
+    {
+        // a new host has no key down
+        memset(route_sent, 0, sizeof(route_sent));
+        for (idx = RPT_IDX_NONE + 1; idx < RPT_IDX_MAX; idx++)
+        {
+            route_sent[idx][0] = report_table[idx].id;
+        }
+    }
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_sendReport(void * ptr, uint16_t len)
+ ********************************************************************************
+ * Summary: Send an input report on the connected link. While disconnected,
+ *          hidd_link keeps the report and reconnects, it is not counted as
+ *          sent.
+ *
+ * Parameters:
+ *  ptr -- pointer to the report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+wiced_bool_t route_sendReport(void * ptr, uint16_t len)
+{
+    uint8_t idx = report_index(WICED_HID_REPORT_TYPE_INPUT, *(uint8_t *)ptr);
+    wiced_bool_t connected = hidd_link_is_connected();
+
+    hidd_link_send_report(ptr, len);
+    if (connected && (idx != RPT_IDX_NONE))
+    {
+        memcpy(route_sent[idx], ptr, len);
+    }
+    return connected;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_isRepeat(void * ptr, uint16_t len)
+ ********************************************************************************
+ * Summary: Check if an input report is the last one sent on the link
+ *
+ * Parameters:
+ *  ptr -- pointer to the report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the host already has this report
+ *
+ *******************************************************************************/
+wiced_bool_t route_isRepeat(void * ptr, uint16_t len)
+{
+    uint8_t idx = report_index(WICED_HID_REPORT_TYPE_INPUT, *(uint8_t *)ptr);
+
+    return (idx != RPT_IDX_NONE) && !memcmp(route_sent[idx], ptr, len);
+}
+
+/********************************************************************************
+ * Function Name: void route_forgetSent(void)
+ ********************************************************************************
+ * Summary: Forget the reports sent on the link
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void route_forgetSent(void)
+{
+    // report ID 0 never matches
+    memset(route_sent, 0, sizeof(route_sent));
+}
+
+#endif // SUPPORT_DUAL_HOST
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Report routing between the LE and BR/EDR hosts
+ *
+ * With DUAL_HOST=1 the keyboard stays connected to one LE host and one BR/EDR
+ * host at the same time. Input reports go to the selected link only. Switching
+ * hosts releases the keys on the old host and brings the new host up to date,
+ * neither link is dropped.
+ *
+ */
+#ifndef __APP_ROUTE_H__
+#define __APP_ROUTE_H__
+
+#include "wiced.h"
+
+/********************************************************************************
+ * Function Name: void route_linkStateChange(uint8_t transport, uint8_t newState)
+ ********************************************************************************
+ * Summary: Track the state of each link. A new host starts with no key down.
+ *          With DUAL_HOST, reports follow the remaining link when the selected
+ *          one goes down.
+ *
+ * Parameters:
+ *  transport -- BT_TRANSPORT_LE or BT_TRANSPORT_BR_EDR
+ *  newState -- new link state
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void route_linkStateChange(uint8_t transport, uint8_t newState);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_sendReport(void * ptr, uint16_t len)
+ ********************************************************************************
+ * Summary: Send an input report on the selected link. The link keeps a copy of
+ *          the report once it is sent.
+ *
+ * Parameters:
+ *  ptr -- pointer to the report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+wiced_bool_t route_sendReport(void * ptr, uint16_t len);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_isRepeat(void * ptr, uint16_t len)
+ ********************************************************************************
+ * Summary: Check if an input report is the last one sent on the selected link
+ *
+ * Parameters:
+ *  ptr -- pointer to the report, starting with the report ID
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the host already has this report
+ *
+ *******************************************************************************/
+wiced_bool_t route_isRepeat(void * ptr, uint16_t len);
+
+/********************************************************************************
+ * Function Name: void route_forgetSent(void)
+ ********************************************************************************
+ * Summary: Forget the reports sent on the selected link, so the next report of
+ *          each kind goes out even if it repeats the last one
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void route_forgetSent(void);
+
+#ifdef SUPPORT_DUAL_HOST
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_select(uint8_t transport)
+ ********************************************************************************
+ * Summary: Route the input reports to the host on the transport
+ *
+ * Parameters:
+ *  transport -- BT_TRANSPORT_LE or BT_TRANSPORT_BR_EDR
+ *
+ * Return:
+ *  TRUE if the reports now go to that link
+ *
+ *******************************************************************************/
+wiced_bool_t route_select(uint8_t transport);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_isConnected(void)
+ ********************************************************************************
+ * Summary: Check if the selected link is connected
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if connected
+ *
+ *******************************************************************************/
+wiced_bool_t route_isConnected(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_isTarget(uint8_t transport)
+ ********************************************************************************
+ * Summary: Check if the input reports go to the host on the transport
+ *
+ * Parameters:
+ *  transport -- BT_TRANSPORT_LE or BT_TRANSPORT_BR_EDR
+ *
+ * Return:
+ *  TRUE if the transport is the selected link
+ *
+ *******************************************************************************/
+wiced_bool_t route_isTarget(uint8_t transport);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t route_txReady(void)
+ ********************************************************************************
+ * Summary: Check if the selected link can take another report
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if there is room for a report
+ *
+ *******************************************************************************/
+wiced_bool_t route_txReady(void);
+
+#else
+# define route_select(t) FALSE
+# define route_isConnected() hidd_link_is_connected()
+# define route_isTarget(t) TRUE
+# define route_txReady() (wiced_bt_buffer_poolutilization(HCI_ACL_POOL_ID) < 80)
+#endif // SUPPORT_DUAL_HOST
+#endif // __APP_ROUTE_H__
@@ -0,0 +1,613 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Settings and statistics journal
+ *
+ * The journal uses JOURNAL_PAGES NVRAM records as a ring of pages. A page
+ * starts with a magic and a sequence number, followed by records:
+ *
+ *   type, len, data[len], crc16
+ *
+ * A write appends the record to the RAM image of the head page and writes the
+ * page to NVRAM. The NVRAM write of a record either completes or leaves the
+ * previous content, and each record carries its own CRC, so a power loss never
+ * leaves a half written record in use.
+ *
+ * When the head page is full the oldest page becomes the new head. Its live
+ * records are carried into the new page image first so nothing is lost when
+ * it is overwritten. journal_compact() does this ahead of time while the
+ * keyboard is idle.
+ *
+ */
+#include "app.h"
+#include "wiced_hal_nvram.h"
+
+#define JOURNAL_MAGIC               0x4a52  // "JR"
+#define JOURNAL_NO_PAGE             0xff
+#define JOURNAL_REC_OVERHEAD        (sizeof(journal_rec_hdr_t) + sizeof(uint16_t))
+#define JOURNAL_SEQ_AFTER(a,b)      ((int16_t)((a) - (b)) > 0)
+
+#pragma pack(1)
+typedef PACKED struct {
+    uint16_t magic;
+    uint16_t seq;                           // page sequence number, 0 when never written
+} journal_page_hdr_t;
+
+typedef PACKED struct {
+    uint8_t  type;
+    uint8_t  len;
+} journal_rec_hdr_t;
+#pragma pack()
+
+typedef struct {
+    uint8_t  page;                          // page holding the live record, JOURNAL_NO_PAGE if none
+    uint8_t  offset;                        // record offset in the page
+} journal_loc_t;
+
+static struct {
+    uint8_t  head;                          // page being appended
+    uint16_t headLen;                       // bytes used in the head page
+    uint16_t seq[JOURNAL_PAGES];            // sequence number of each page
+    journal_loc_t loc[JOURNAL_REC_MAX];     // live record of each type
+    uint8_t  page[JOURNAL_PAGE_SIZE];       // head page image
+    uint8_t  scratch[JOURNAL_PAGE_SIZE];    // other page being read
+    uint8_t  batch;                         // writes are held in the head page image until journal_batchEnd()
+    uint8_t  uncommitted;                   // head page image has records not yet written
+    uint8_t  compacted;                     // no write since journal_compact() last ran
+} journal;
+
+/********************************************************************************
+ * Function Name: JOURNAL_crc16
+ ********************************************************************************
+ * Summary: CRC16 (CCITT) of a buffer
+ *
+ * Parameters:
+ *  buf -- data
+ *  len -- data length
+ *
+ * Return:
+ *  crc
+ *
+ *******************************************************************************/
+STATIC uint16_t JOURNAL_crc16(const uint8_t * buf, uint16_t len)
+{
+    uint16_t crc = 0xffff;
+    uint8_t bit;
+
+    while (len--)
+    {
+        crc ^= (uint16_t) *buf++ << 8;
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_recValid
+ ********************************************************************************
+ * Summary: check the record at the offset of a page image
+ *
+ * Parameters:
+ *  buf -- page image
+ *  len -- page image length
+ *  offset -- record offset
+ *
+ * Return:
+ *  record size, 0 if there is no valid record at the offset
+ *
+ *******************************************************************************/
+STATIC uint16_t JOURNAL_recValid(const uint8_t * buf, uint16_t len, uint16_t offset)
+{
+    const journal_rec_hdr_t * rec = (const journal_rec_hdr_t *) &buf[offset];
+    uint16_t size, crc;
+
+    if (offset + sizeof(journal_rec_hdr_t) > len)
+    {
+        return 0;
+    }
+
+    size = JOURNAL_REC_OVERHEAD + rec->len;
+    if ((offset + size > len) || (rec->type == JOURNAL_REC_NONE))
+    {
+        return 0;
+    }
+
+    memcpy(&crc, &buf[offset + size - sizeof(uint16_t)], sizeof(uint16_t));
+    return (JOURNAL_crc16(&buf[offset], size - sizeof(uint16_t)) == crc) ? size : 0;
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_load
+ ********************************************************************************
+ * Summary: read a page from NVRAM
+ *
+ * Parameters:
+ *  idx -- page index
+ *  buf -- page image
+ *
+ * Return:
+ *  page length, 0 if the page is not a journal page
+ *
+ *******************************************************************************/
+STATIC uint16_t JOURNAL_load(uint8_t idx, uint8_t * buf)
+{
+    journal_page_hdr_t * hdr = (journal_page_hdr_t *) buf;
+    wiced_result_t result;
+    uint16_t len;
+
+    len = wiced_hal_read_nvram(VS_ID_JOURNAL + idx, JOURNAL_PAGE_SIZE, buf, &result);
+    if ((result != WICED_SUCCESS) || (len < sizeof(journal_page_hdr_t)) || (hdr->magic != JOURNAL_MAGIC) || !hdr->seq)
+    {
+        return 0;
+    }
+    return len;
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_scan
+ ********************************************************************************
+ * Summary: walk the records of a page image and update the live records
+ *
+ * Parameters:
+ *  idx -- page index
+ *  buf -- page image
+ *  len -- page image length
+ *
+ * Return:
+ *  end of the last valid record
+ *
+ *******************************************************************************/
+STATIC uint16_t JOURNAL_scan(uint8_t idx, const uint8_t * buf, uint16_t len)
+{
+    const journal_rec_hdr_t * rec;
+    uint16_t offset = sizeof(journal_page_hdr_t);
+    uint16_t size;
+
+    while ((size = JOURNAL_recValid(buf, len, offset)) != 0)
+    {
+        rec = (const journal_rec_hdr_t *) &buf[offset];
+        if (rec->type < JOURNAL_REC_MAX)
+        {
+            journal.loc[rec->type].page = rec->len ? idx : JOURNAL_NO_PAGE;
+            journal.loc[rec->type].offset = offset;
+        }
+        offset += size;
+    }
+    return offset;
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_append
+ ********************************************************************************
+ * Summary: append a record to the head page image. The caller checks there is
+ *          room for it.
+ *
+ * Parameters:
+ *  type -- record type
+ *  data -- record data
+ *  len -- data length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void JOURNAL_append(uint8_t type, const void * data, uint8_t len)
+{
+    journal_rec_hdr_t * rec = (journal_rec_hdr_t *) &journal.page[journal.headLen];
+    uint16_t crc;
+
+    rec->type = type;
+    rec->len = len;
+    memcpy(&rec[1], data, len);
+    crc = JOURNAL_crc16((uint8_t *) rec, sizeof(journal_rec_hdr_t) + len);
+    memcpy(&journal.page[journal.headLen + sizeof(journal_rec_hdr_t) + len], &crc, sizeof(uint16_t));
+
+    journal.loc[type].page = len ? journal.head : JOURNAL_NO_PAGE;
+    journal.loc[type].offset = journal.headLen;
+    journal.headLen += JOURNAL_REC_OVERHEAD + len;
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_carry
+ ********************************************************************************
+ * Summary: append the live records found in a page to the head page image
+ *
+ * Parameters:
+ *  idx -- page index
+ *  buf -- page image
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void JOURNAL_carry(uint8_t idx, const uint8_t * buf)
+{
+    const journal_rec_hdr_t * rec;
+    uint8_t type;
+
+    for (type = JOURNAL_REC_NONE + 1; type < JOURNAL_REC_MAX; type++)
+    {
+        if (journal.loc[type].page == idx)
+        {
+            rec = (const journal_rec_hdr_t *) &buf[journal.loc[type].offset];
+            JOURNAL_append(type, &rec[1], rec->len);
+        }
+    }
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_liveSize
+ ********************************************************************************
+ * Summary: bytes taken by the live records of a page
+ *
+ * Parameters:
+ *  idx -- page index
+ *  buf -- page image, NULL when only checking for live records
+ *
+ * Return:
+ *  size of the live records, 1 if any record is live and buf is NULL
+ *
+ *******************************************************************************/
+STATIC uint16_t JOURNAL_liveSize(uint8_t idx, const uint8_t * buf)
+{
+    uint16_t size = 0;
+    uint8_t type;
+
+    for (type = JOURNAL_REC_NONE + 1; type < JOURNAL_REC_MAX; type++)
+    {
+        if (journal.loc[type].page == idx)
+        {
+            if (!buf)
+            {
+                return 1;
+            }
+            size += JOURNAL_REC_OVERHEAD + ((const journal_rec_hdr_t *) &buf[journal.loc[type].offset])->len;
+        }
+    }
+    return size;
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_commit
+ ********************************************************************************
+ * Summary: write the head page image to NVRAM
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if written
+ *
+ *******************************************************************************/
+STATIC wiced_bool_t JOURNAL_commit(void)
+{
+    wiced_result_t result;
+
+    wiced_hal_write_nvram(VS_ID_JOURNAL + journal.head, journal.headLen, journal.page, &result);
+    if (result != WICED_SUCCESS)
+    {
+        WICED_BT_TRACE("\njournal: page %d write failed %d", journal.head, result);
+        return FALSE;
+    }
+    journal.uncommitted = FALSE;
+    return TRUE;
+}
+
+/********************************************************************************
+ * Function Name: JOURNAL_advance
+ ********************************************************************************
+ * Summary: start a new head page in the oldest page. The live records of the
+ *          oldest page are carried into the new page and written back.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void JOURNAL_advance(void)
+{
+    journal_page_hdr_t * hdr = (journal_page_hdr_t *) journal.page;
+    uint16_t seq = journal.seq[journal.head] + 1;
+    uint8_t next = (journal.head + 1) % JOURNAL_PAGES;
+    uint8_t carry = JOURNAL_liveSize(next, NULL) != 0;
+    uint8_t type;
+
+    // records held by a batch go out with the page they were appended to
+    if (journal.uncommitted)
+    {
+        JOURNAL_commit();
+    }
+
+    if (carry && !JOURNAL_load(next, journal.scratch))
+    {
+        // the page cannot be read back, its records are lost
+        WICED_BT_TRACE("\njournal: page %d unreadable", next);
+        for (type = JOURNAL_REC_NONE + 1; type < JOURNAL_REC_MAX; type++)
+        {
+            if (journal.loc[type].page == next)
+            {
+                journal.loc[type].page = JOURNAL_NO_PAGE;
+            }
+        }
+        carry = FALSE;
+    }
+
+    journal.head = next;
+    journal.seq[next] = seq ? seq : 1;
+    hdr->magic = JOURNAL_MAGIC;
+    hdr->seq = journal.seq[next];
+    journal.headLen = sizeof(journal_page_hdr_t);
+
+    if (carry)
+    {
+        // commit now, the caller may have to switch page again
+        JOURNAL_carry(next, journal.scratch);
+        JOURNAL_commit();
+    }
+}
+
+/********************************************************************************
+ * Function Name: void journal_init(void)
+ ********************************************************************************
+ * Summary: Scan the journal pages and locate the live record of each type.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void journal_init(void)
+{
+    journal_page_hdr_t * hdr = (journal_page_hdr_t *) journal.scratch;
+    uint8_t idx, n;
+
+    memset(&journal, 0, sizeof(journal));
+    memset(journal.loc, JOURNAL_NO_PAGE, sizeof(journal.loc));
+
+    // the head is the page with the latest sequence number
+    for (idx = 0; idx < JOURNAL_PAGES; idx++)
+    {
+        if (JOURNAL_load(idx, journal.scratch))
+        {
+            journal.seq[idx] = hdr->seq;
+            if (!journal.seq[journal.head] || JOURNAL_SEQ_AFTER(hdr->seq, journal.seq[journal.head]))
+            {
+                journal.head = idx;
+            }
+        }
+    }
+
+    // pages are written in turn, so the oldest one follows the head
+    for (n = 1; n <= JOURNAL_PAGES; n++)
+    {
+        idx = (journal.head + n) % JOURNAL_PAGES;
+        if (journal.seq[idx])
+        {
+            uint16_t len = JOURNAL_load(idx, journal.scratch);
+            uint16_t end = JOURNAL_scan(idx, journal.scratch, len);
+
+            if (idx == journal.head)
+            {
+                memcpy(journal.page, journal.scratch, end);
+                journal.headLen = end;
+            }
+        }
+    }
+
+    if (!journal.seq[journal.head])
+    {
+        // blank journal
+        hdr = (journal_page_hdr_t *) journal.page;
+        hdr->magic = JOURNAL_MAGIC;
+        hdr->seq = journal.seq[journal.head] = 1;
+        journal.headLen = sizeof(journal_page_hdr_t);
+    }
+
+    WICED_BT_TRACE("\njournal: head page %d seq %d, %d bytes", journal.head, journal.seq[journal.head], journal.headLen);
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t journal_write(uint8_t type, const void *data, uint8_t len)
+ ********************************************************************************
+ * Summary: Append a record. It replaces the previous record of the same type.
+ *
+ * Parameters:
+ *  type -- journal_rec_e
+ *  data -- record data
+ *  len -- data length, 0 to delete the type
+ *
+ * Return:
+ *  TRUE if the record is committed to NVRAM
+ *
+ *******************************************************************************/
+wiced_bool_t journal_write(uint8_t type, const void *data, uint8_t len)
+{
+    uint8_t n;
+
+    if ((type == JOURNAL_REC_NONE) || (type >= JOURNAL_REC_MAX) || (len > JOURNAL_MAX_DATA))
+    {
+        return FALSE;
+    }
+
+    // nothing to append when the live record is the same
+    if (journal.loc[type].page == JOURNAL_NO_PAGE ? !len :
+        ((journal_read(type, journal.scratch, JOURNAL_MAX_DATA) == len) && !memcmp(journal.scratch, data, len)))
+    {
+        return TRUE;
+    }
+
+    // carried records can fill the new page, try the following one
+    for (n = 0; journal.headLen + JOURNAL_REC_OVERHEAD + len > JOURNAL_PAGE_SIZE; n++)
+    {
+        if (n == JOURNAL_PAGES)
+        {
+            WICED_BT_TRACE("\njournal: full");
+            return FALSE;
+        }
+        JOURNAL_advance();
+    }
+
+    JOURNAL_append(type, data, len);
+    journal.compacted = FALSE;
+    if (journal.batch)
+    {
+        journal.uncommitted = TRUE;
+        return TRUE;
+    }
+    return JOURNAL_commit();
+}
+
+/********************************************************************************
+ * Function Name: void journal_batchBegin(void)
+ ********************************************************************************
+ * Summary: Hold the following writes in the head page image, so records written
+ *          together take one page write instead of one each.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void journal_batchBegin(void)
+{
+    journal.batch = TRUE;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t journal_batchEnd(void)
+ ********************************************************************************
+ * Summary: Write the records held since journal_batchBegin()
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if the records are committed to NVRAM
+ *
+ *******************************************************************************/
+wiced_bool_t journal_batchEnd(void)
+{
+    journal.batch = FALSE;
+    return journal.uncommitted ? JOURNAL_commit() : TRUE;
+}
+
+/********************************************************************************
+ * Function Name: uint8_t journal_read(uint8_t type, void *buf, uint8_t len)
+ ********************************************************************************
+ * Summary: Read the live record of a type
+ *
+ * Parameters:
+ *  type -- journal_rec_e
+ *  buf -- destination
+ *  len -- buffer size
+ *
+ * Return:
+ *  bytes read, 0 if there is no record of that type
+ *
+ *******************************************************************************/
+uint8_t journal_read(uint8_t type, void *buf, uint8_t len)
+{
+    const journal_rec_hdr_t * rec;
+    const uint8_t * page = journal.page;
+
+    if ((type >= JOURNAL_REC_MAX) || (journal.loc[type].page == JOURNAL_NO_PAGE))
+    {
+        return 0;
+    }
+
+    if (journal.loc[type].page != journal.head)
+    {
+        if (!JOURNAL_load(journal.loc[type].page, journal.scratch))
+        {
+            return 0;
+        }
+        page = journal.scratch;
+    }
+
+    rec = (const journal_rec_hdr_t *) &page[journal.loc[type].offset];
+    if (len > rec->len)
+    {
+        len = rec->len;
+    }
+    memmove(buf, &rec[1], len);
+    return len;
+}
+
+/********************************************************************************
+ * Function Name: void journal_compact(void)
+ ********************************************************************************
+ * Summary: Move the live records out of the oldest page while the keyboard is
+ *          idle. One page write at most per call. Once it has run, later calls
+ *          return at once until the next write.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void journal_compact(void)
+{
+    uint8_t oldest = (journal.head + 1) % JOURNAL_PAGES;
+
+    // the pages only change with a write, a second pass would find the same
+    if (journal.compacted)
+    {
+        return;
+    }
+    journal.compacted = TRUE;
+
+    if (!JOURNAL_liveSize(oldest, NULL) || !JOURNAL_load(oldest, journal.scratch))
+    {
+        return;
+    }
+
+    // when they do not fit, the page switch carries them instead
+    if (journal.headLen + JOURNAL_liveSize(oldest, journal.scratch) <= JOURNAL_PAGE_SIZE)
+    {
+        JOURNAL_carry(oldest, journal.scratch);
+        JOURNAL_commit();
+    }
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Settings and statistics journal
+ *
+ * Small append only store for keyboard settings and statistics. Each record
+ * has a type, only the latest record of a type is live. Records are appended
+ * to the head page and the pages are used in turn, so the writes are spread
+ * over the whole reserved NVRAM range instead of rewriting one record per
+ * setting.
+ *
+ */
+#ifndef __APP_JOURNAL_H__
+#define __APP_JOURNAL_H__
+
+#include "wiced.h"
+
+#define JOURNAL_PAGES               8       // NVRAM records reserved for the journal
+#define JOURNAL_PAGE_SIZE           240     // bytes in one page
+#define JOURNAL_MAX_DATA            72      // largest record data, a page holds three of them
+
+/// record types, one live record per type
+typedef enum {
+    JOURNAL_REC_NONE,                       // reserved
+    JOURNAL_REC_KEY_PRESS,                  // 9 records, press totals of 16 keys each
+    JOURNAL_REC_KEY_CHATTER = JOURNAL_REC_KEY_PRESS + 9,   // 5 records, chatter totals of 32 keys each
+    JOURNAL_REC_LE_LINK = JOURNAL_REC_KEY_CHATTER + 5,     // LE PHY and data length of the recent hosts
+    JOURNAL_REC_LE_RECONNECT,                               // LE time to reconnect statistics
+    JOURNAL_REC_MAX
+} journal_rec_e;
+
+/********************************************************************************
+ * Function Name: void journal_init(void)
+ ********************************************************************************
+ * Summary: Scan the journal pages and locate the live record of each type.
+ *          Records left half written by a power loss are dropped.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void journal_init(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t journal_write(uint8_t type, const void *data, uint8_t len)
+ ********************************************************************************
+ * Summary: Append a record. It replaces the previous record of the same type.
+ *          A zero length record deletes the type.
+ *
+ * Parameters:
+ *  type -- journal_rec_e
+ *  data -- record data
+ *  len -- data length, up to JOURNAL_MAX_DATA
+ *
+ * Return:
+ *  TRUE if the record is committed to NVRAM
+ *
+ *******************************************************************************/
+wiced_bool_t journal_write(uint8_t type, const void *data, uint8_t len);
+
+/********************************************************************************
+ * Function Name: void journal_batchBegin(void)
+ ********************************************************************************
+ * Summary: Hold the following writes in RAM until journal_batchEnd(). Records
+ *          written together then take one page write instead of one each.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void journal_batchBegin(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t journal_batchEnd(void)
+ ********************************************************************************
+ * Summary: Write the records held since journal_batchBegin()
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if the records are committed to NVRAM
+ *
+ *******************************************************************************/
+wiced_bool_t journal_batchEnd(void);
+
+/********************************************************************************
+ * Function Name: uint8_t journal_read(uint8_t type, void *buf, uint8_t len)
+ ********************************************************************************
+ * Summary: Read the live record of a type
+ *
+ * Parameters:
+ *  type -- journal_rec_e
+ *  buf -- destination
+ *  len -- buffer size
+ *
+ * Return:
+ *  bytes read, 0 if there is no record of that type
+ *
+ *******************************************************************************/
+uint8_t journal_read(uint8_t type, void *buf, uint8_t len);
+
+/********************************************************************************
+ * Function Name: void journal_compact(void)
+ ********************************************************************************
+ * Summary: Called when the keyboard is idle. Moves the live records out of the
+ *          oldest page so the next page switch does not have to read and
+ *          copy them while keys are being processed. Runs once until the next
+ *          journal_write().
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void journal_compact(void);
+
+#endif // __APP_JOURNAL_H__
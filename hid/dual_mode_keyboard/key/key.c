@@ -64,6 +64,7 @@
 #define USE_FUNCTION_KEYS 0
 #if USE_FUNCTION_KEYS
  #define FN_KEY_TYPE KEY_TYPE_STD
+ #define FN_MEDIA_KEY_TYPE KEY_TYPE_STD
  #define FN1_KEYCODE USB_USAGE_F1
  #define FN2_KEYCODE USB_USAGE_F2
  #define FN3_KEYCODE USB_USAGE_F3
@@ -76,18 +77,111 @@
  #define FN10_KEYCODE USB_USAGE_F10
 #else
  #define FN_KEY_TYPE KEY_TYPE_BIT_MAPPED
+ #define FN_MEDIA_KEY_TYPE KEY_TYPE_CONSUMER
  #define FN1_KEYCODE BIT_MAPPED_LIGHT_DOWN
  #define FN2_KEYCODE BIT_MAPPED_LIGHT_UP
  #define FN3_KEYCODE BIT_MAPPED_EDIT
  #define FN4_KEYCODE BIT_MAPPED_SEARCH
  #define FN5_KEYCODE BIT_MAPPED_COPY
  #define FN6_KEYCODE BIT_MAPPED_EDIT
- #define FN7_KEYCODE BIT_MAPPED_REWIND
- #define FN8_KEYCODE BIT_MAPPED_PLAY_PAUSE
- #define FN9_KEYCODE BIT_MAPPED_FAST_FORWARD
- #define FN10_KEYCODE USB_USAGE_MUTE
+ #define FN7_KEYCODE CC_REWIND
+ #define FN8_KEYCODE CC_PLAY_PAUSE
+ #define FN9_KEYCODE CC_FAST_FORWARD
+ #define FN10_KEYCODE CC_MUTE
 #endif
 
+#ifdef SUPPORT_MACRO
+ // FN3 starts/stops recording, FN4 to FN6 are the macro keys
+ #define FN3_KEY_TYPE KEY_TYPE_MACRO_REC
+ #define FN4_KEY_TYPE KEY_TYPE_MACRO
+ #define FN5_KEY_TYPE KEY_TYPE_MACRO
+ #define FN6_KEY_TYPE KEY_TYPE_MACRO
+ #undef FN3_KEYCODE
+ #undef FN4_KEYCODE
+ #undef FN5_KEYCODE
+ #undef FN6_KEYCODE
+ #define FN3_KEYCODE 0
+ #define FN4_KEYCODE 0
+ #define FN5_KEYCODE 1
+ #define FN6_KEYCODE 2
+#else
+ #define FN3_KEY_TYPE FN_KEY_TYPE
+ #define FN4_KEY_TYPE FN_KEY_TYPE
+ #define FN5_KEY_TYPE FN_KEY_TYPE
+ #define FN6_KEY_TYPE FN_KEY_TYPE
+#endif
+
+#ifdef SUPPORT_DUAL_HOST
+ // FN1 sends the keys to the LE host, FN2 to the BR/EDR host
+ #define FN1_KEY_TYPE KEY_TYPE_HOST
+ #define FN2_KEY_TYPE KEY_TYPE_HOST
+ #undef FN1_KEYCODE
+ #undef FN2_KEYCODE
+ #define FN1_KEYCODE BT_TRANSPORT_LE
+ #define FN2_KEYCODE BT_TRANSPORT_BR_EDR
+#else
+ #define FN1_KEY_TYPE FN_KEY_TYPE
+ #define FN2_KEY_TYPE FN_KEY_TYPE
+#endif
+
+/// Dual role keys. Tapped, they report the tap usage. Held past the tapping term, or
+/// held while another key is tapped, they act as the hold modifier.
+enum
+{
+    TH_ESC_CTL,         // Esc when tapped, left Ctrl when held
+    TH_SPACE_SHIFT,     // Space when tapped, right Shift when held
+    TH_MAX
+};
+
+#define USE_TAP_HOLD 0
+#if USE_TAP_HOLD
+ #define ESC_KEY_TYPE   KEY_TYPE_TAP_HOLD
+ #define ESC_KEYCODE    TH_ESC_CTL
+ #define SPACE_KEY_TYPE KEY_TYPE_TAP_HOLD
+ #define SPACE_KEYCODE  TH_SPACE_SHIFT
+#else
+ #define ESC_KEY_TYPE   KEY_TYPE_STD
+ #define ESC_KEYCODE    USB_USAGE_ESCAPE
+ #define SPACE_KEY_TYPE KEY_TYPE_STD
+ #define SPACE_KEYCODE  USB_USAGE_SPACEBAR
+#endif
+
+#define KEY_TAP_HOLD_TERM_MS        200     // held longer than this resolves to hold
+#define KEY_TAP_HOLD_PERMISSIVE     1       // another key pressed and released while pending resolves to hold
+#define KEY_TAP_HOLD_ON_INTERRUPT   0       // another key pressed while pending resolves to hold
+#define KEY_TAP_HOLD_BUF_SIZE       8       // key events held back while a dual role key is pending
+#define KEY_TAP_HOLD_REPLAY_SIZE    (KEY_TAP_HOLD_BUF_SIZE * 2) // held back events waiting for a report to go out
+
+/// Combos, keys pressed together within the combo window that report another key.
+/// The combo index is a bit in the per key membership mask, so at most 8 combos.
+enum
+{
+    COMBO_JK_ESC,       // J+K reports Esc
+    COMBO_MAX
+};
+
+#define USE_COMBO 0
+#define KEY_COMBO_TERM_MS           50      // all keys of a combo must go down within this window
+#define KEY_COMBO_MAX_KEYS          3
+#define KEY_IDX_J                   42
+#define KEY_IDX_K                   50
+
+/// Consumer control usage table, indexed by the CC_ translation value
+static const uint16_t key_ccUsage[CC_MAX] =
+{
+    [CC_MUTE]         = CC_USAGE_MUTE,
+    [CC_VOL_UP]       = CC_USAGE_VOL_UP,
+    [CC_VOL_DOWN]     = CC_USAGE_VOL_DOWN,
+    [CC_PLAY_PAUSE]   = CC_USAGE_PLAY_PAUSE,
+    [CC_NEXT_TRACK]   = CC_USAGE_NEXT_TRACK,
+    [CC_PREV_TRACK]   = CC_USAGE_PREV_TRACK,
+    [CC_FAST_FORWARD] = CC_USAGE_FAST_FORWRD,
+    [CC_REWIND]       = CC_USAGE_REWIND,
+    [CC_AC_SEARCH]    = CC_USAGE_AC_SEARCH,
+    [CC_AC_HOME]      = CC_USAGE_AC_HOME,
+    [CC_AC_BACK]      = CC_USAGE_AC_BACK,
+};
+
 enum
 {
     USB_MODKEY_MASK_LEFT_CTL=0x01,
@@ -100,6 +194,32 @@ enum
     USB_MODKEY_MASK_RIGHT_GUI=0x80
 };
 
+/// Dual role key config, indexed by the TH_ translation value
+typedef struct
+{
+    uint8_t tapUsage;       // standard key usage reported when tapped
+    uint8_t holdModifier;   // modifier mask applied when held
+} KeyTapHoldConfig;
+
+static const KeyTapHoldConfig key_tapHold[TH_MAX] =
+{
+    [TH_ESC_CTL]     = {USB_USAGE_ESCAPE,   USB_MODKEY_MASK_LEFT_CTL},
+    [TH_SPACE_SHIFT] = {USB_USAGE_SPACEBAR, USB_MODKEY_MASK_RIGHT_SHIFT},
+};
+
+/// Combo config, indexed by the COMBO_ value
+typedef struct
+{
+    uint8_t     keyCount;                   // number of keys in the combo, 2 or more
+    uint8_t     keys[KEY_COMBO_MAX_KEYS];   // key indexes that must go down together
+    KbKeyConfig out;                        // key reported while the combo is held
+} KeyComboConfig;
+
+static const KeyComboConfig key_combo[COMBO_MAX] =
+{
+    [COMBO_JK_ESC] = {2, {KEY_IDX_J, KEY_IDX_K}, {KEY_TYPE_STD, USB_USAGE_ESCAPE}},
+};
+
 /// Keyboard Key Config
 
 /// Key types. Used to direct key codes to the relevant key processing function
@@ -110,8 +230,10 @@ enum
 /// will be reported in the standard report with a USB usage of "ESCAPE"
 /// See config documentation for details and the keyboard config for an example.
 /// By default this table is initialized for the BCM keyboard
+/// This built-in table stays in flash. The key processing uses the RAM copy in
+/// kbKeyConfig, which a keymap uploaded at runtime replaces.
 *****************************************************************************/
-KbKeyConfig kbKeyConfig[] =
+static const KbKeyConfig key_defaultConfig[] =
 {
 // Column 0:  row0 ->row7
 /*   0 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
@@ -121,13 +243,13 @@ KbKeyConfig kbKeyConfig[] =
 /*   4 */ {KEY_TYPE_BIT_MAPPED, BIT_MAPPED_RGB},
 /*   5 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*   6 */ {KEY_TYPE_BIT_MAPPED, BIT_MAPPED_FUNCTION},
-/*   7 */ {FN_KEY_TYPE,         FN5_KEYCODE},
+/*   7 */ {FN5_KEY_TYPE,        FN5_KEYCODE},
 
 // Column 1: order is row0 ->row7
 /*   8 */ {KEY_TYPE_STD,        USB_USAGE_Q},
 /*   9 */ {KEY_TYPE_STD,        USB_USAGE_TAB},
 /*  10 */ {KEY_TYPE_STD,        USB_USAGE_A},
-/*  11 */ {KEY_TYPE_STD,        USB_USAGE_ESCAPE},
+/*  11 */ {ESC_KEY_TYPE,        ESC_KEYCODE},
 /*  12 */ {KEY_TYPE_STD,        USB_USAGE_Z},
 /*  13 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*  14 */ {KEY_TYPE_STD,        USB_USAGE_ACCENT},
@@ -140,17 +262,17 @@ KbKeyConfig kbKeyConfig[] =
 /*  19 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*  20 */ {KEY_TYPE_STD,        USB_USAGE_X},
 /*  21 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
-/*  22 */ {FN_KEY_TYPE,         FN1_KEYCODE},
+/*  22 */ {FN1_KEY_TYPE,        FN1_KEYCODE},
 /*  23 */ {KEY_TYPE_STD,        USB_USAGE_2},
 
 // Column 3: order is row0 ->row7
 /*  24 */ {KEY_TYPE_STD,        USB_USAGE_E},
-/*  25 */ {FN_KEY_TYPE,         FN3_KEYCODE},
+/*  25 */ {FN3_KEY_TYPE,        FN3_KEYCODE},
 /*  26 */ {KEY_TYPE_STD,        USB_USAGE_D},
-/*  27 */ {FN_KEY_TYPE,         FN4_KEYCODE},
+/*  27 */ {FN4_KEY_TYPE,        FN4_KEYCODE},
 /*  28 */ {KEY_TYPE_STD,        USB_USAGE_C},
 /*  29 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
-/*  30 */ {FN_KEY_TYPE,         FN2_KEYCODE},
+/*  30 */ {FN2_KEY_TYPE,        FN2_KEYCODE},
 /*  31 */ {KEY_TYPE_STD,        USB_USAGE_3},
 
 // Column 4: order is row0 ->row7
@@ -177,7 +299,7 @@ KbKeyConfig kbKeyConfig[] =
 /*  48 */ {KEY_TYPE_STD,        USB_USAGE_I},
 /*  49 */ {KEY_TYPE_STD,        USB_USAGE_RIGHT_BRACKET},
 /*  50 */ {KEY_TYPE_STD,        USB_USAGE_K},
-/*  51 */ {FN_KEY_TYPE,         FN6_KEYCODE},
+/*  51 */ {FN6_KEY_TYPE,        FN6_KEYCODE},
 /*  52 */ {KEY_TYPE_STD,        USB_USAGE_COMMA},
 /*  53 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*  54 */ {KEY_TYPE_STD,        USB_USAGE_EQUAL},
@@ -191,7 +313,7 @@ KbKeyConfig kbKeyConfig[] =
 /*  60 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*  61 */ {KEY_TYPE_BIT_MAPPED, BIT_MAPPED_LIGHT},
 /*  62 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
-/*  63 */ {KEY_TYPE_STD,        USB_USAGE_VOL_UP},
+/*  63 */ {KEY_TYPE_CONSUMER,   CC_VOL_UP},
 
 // Column 8: order is row0 ->row7
 /*  64 */ {KEY_TYPE_STD,        USB_USAGE_P},
@@ -210,8 +332,8 @@ KbKeyConfig kbKeyConfig[] =
 /*  75 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*  76 */ {KEY_TYPE_STD,        USB_USAGE_ENTER},
 /*  77 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
-/*  78 */ {FN_KEY_TYPE,         FN9_KEYCODE},
-/*  79 */ {KEY_TYPE_STD,        FN10_KEYCODE},  // both F10 or MUTE keys are STD KEY
+/*  78 */ {FN_MEDIA_KEY_TYPE,   FN9_KEYCODE},
+/*  79 */ {FN_MEDIA_KEY_TYPE,   FN10_KEYCODE},  // F10 or MUTE
 
 // Column 10: order is row0 ->row7
 /*  80 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
@@ -227,8 +349,8 @@ KbKeyConfig kbKeyConfig[] =
 /*  88 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*  89 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /*  90 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
-/*  91 */ {KEY_TYPE_STD,        USB_USAGE_SPACEBAR},
-/*  92 */ {KEY_TYPE_STD,        USB_USAGE_VOL_DOWN},
+/*  91 */ {SPACE_KEY_TYPE,      SPACE_KEYCODE},
+/*  92 */ {KEY_TYPE_CONSUMER,   CC_VOL_DOWN},
 /*  93 */ {KEY_TYPE_STD,        USB_USAGE_DOWN_ARROW},
 /*  94 */ {KEY_TYPE_STD,        USB_USAGE_SCROLL_LOCK},
 /*  95 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
@@ -255,12 +377,12 @@ KbKeyConfig kbKeyConfig[] =
 
 // Column 14: order is row0 ->row7
 /* 112 */ {KEY_TYPE_STD,        USB_USAGE_O},
-/* 113 */ {FN_KEY_TYPE,         FN7_KEYCODE},
+/* 113 */ {FN_MEDIA_KEY_TYPE,   FN7_KEYCODE},
 /* 114 */ {KEY_TYPE_STD,        USB_USAGE_L},
 /* 115 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
 /* 116 */ {KEY_TYPE_STD,        USB_USAGE_STOP_AND_GREATER},
 /* 117 */ {KEY_TYPE_NONE,       USB_USAGE_NO_EVENT},
-/* 118 */ {FN_KEY_TYPE,         FN8_KEYCODE},
+/* 118 */ {FN_MEDIA_KEY_TYPE,   FN8_KEYCODE},
 /* 119 */ {KEY_TYPE_STD,        USB_USAGE_9},
 
 // Column 15: order is row0 ->row7
@@ -295,7 +417,10 @@ KbKeyConfig kbKeyConfig[] =
 
 };
 
-#define KEY_TABLE_SIZE (sizeof(kbKeyConfig)/sizeof(KbKeyConfig))
+#define KEY_TABLE_SIZE (sizeof(key_defaultConfig)/sizeof(KbKeyConfig))
+
+/// Key table in use
+KbKeyConfig kbKeyConfig[KEY_TABLE_SIZE];
 
 //////////////////////////////////////////////////////////////////////////////
 typedef struct {
@@ -305,12 +430,53 @@ typedef struct {
     uint8_t                 funcLock_changed:1;
     uint8_t                 sleep_changed:1;
     uint8_t                 scroll_changed:1;
+    uint8_t                 consumer_changed:1;
 #ifdef SUPPORT_CODE_ENTRY
     uint8_t                 pin_changed:1;
 #endif
+#ifdef SUPPORT_SCROLL
+    int16_t                 scrollAccum;    // scroll motion not sent yet
+#endif
 } kbrpt_t;
 static kbrpt_t keyRpt;
 
+/// Dual role key resolver state
+typedef struct {
+    uint8_t                 keyCode;
+    uint8_t                 keyDown;
+} key_evt_t;
+
+typedef struct {
+    uint8_t                 pending;        // a dual role key is down and not resolved yet
+    uint8_t                 keyCode;        // the pending dual role key
+    uint32_t                startBtClk;     // when the pending key went down
+    uint8_t                 count;          // number of events held back in buf
+    key_evt_t               buf[KEY_TAP_HOLD_BUF_SIZE];
+    uint8_t                 tapRelease;     // tap usage to release once its press is sent, 0 if none
+    uint8_t                 boundary;       // the reports so far must be sent before the replay goes on
+    uint8_t                 replaying;      // KeyRpt_tapHoldReplay is running
+    uint8_t                 replayCount;    // number of events left to replay
+    key_evt_t               replay[KEY_TAP_HOLD_REPLAY_SIZE];
+} key_tap_hold_t;
+static key_tap_hold_t keyTapHold;
+static void KeyRpt_tapHoldStage(uint8_t keyCode, uint8_t keyDown);
+static wiced_bool_t KeyRpt_reportPending(void);
+
+/// Combo engine state
+typedef struct {
+    uint8_t                 candidates;     // combos the held back keys can still complete
+    uint8_t                 count;          // number of keys held back
+    uint8_t                 buf[KEY_COMBO_MAX_KEYS];    // held back keys in press order
+    uint8_t                 held[(KEY_TABLE_SIZE + 7) / 8]; // held back keys, bit per key index
+    uint32_t                startBtClk;     // when the first key was held back
+    uint8_t                 active;         // combo being reported
+    uint8_t                 activeKeys;     // keys of the active combo not released yet, bit per keys[] slot
+} key_combo_t;
+static key_combo_t keyCombo;
+
+// combos each key is part of, bit per combo index. Built by key_configInit
+static uint8_t key_comboMember[KEY_TABLE_SIZE];
+
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
 
@@ -321,12 +487,28 @@ key_input_rpt_t key_rpts = {
     .funcLockReport  = {RPT_ID_IN_FUNC_LOCK},
     .sleepReport     = {RPT_ID_IN_SLEEP},
     .scrollReport    = {RPT_ID_IN_SCROLL},
+    .consumerReport  = {RPT_ID_IN_CONSUMER},
 #ifdef SUPPORT_CODE_ENTRY
     .pinReport       = {RPT_ID_IN_PIN},
 #endif
     .ledReport       = {RPT_ID_OUT_KB_LED},
 };
 
+// Input reports as last sent to the host. Host reads are served from here so
+// they never see a report half way through an update. The LED output report
+// is written by the host and lives in key_rpts only.
+key_input_rpt_t key_snapshot = {
+    .stdRpt          = {RPT_ID_IN_STD_KEY},
+    .bitMappedReport = {RPT_ID_IN_BIT_MAPPED},
+    .funcLockReport  = {RPT_ID_IN_FUNC_LOCK},
+    .sleepReport     = {RPT_ID_IN_SLEEP},
+    .scrollReport    = {RPT_ID_IN_SCROLL},
+    .consumerReport  = {RPT_ID_IN_CONSUMER},
+#ifdef SUPPORT_CODE_ENTRY
+    .pinReport       = {RPT_ID_IN_PIN},
+#endif
+};
+
 /////////////////////////////////////////////////////////////////////////////////
 /// This function transmits the remote report over the interrupt channel and
 /********************************************************************************
@@ -341,7 +523,7 @@ key_input_rpt_t key_rpts = {
  *  none
  *
  *******************************************************************************/
-static void KeyRpt_stdRptProcEvtKeyDown(uint8_t key)
+APP_HOT static void KeyRpt_stdRptProcEvtKeyDown(uint8_t key)
 {
     uint8_t i;
     uint8_t * keyCodes = key_rpts.stdRpt.keyCodes;
@@ -379,7 +561,7 @@ static void KeyRpt_stdRptProcEvtKeyDown(uint8_t key)
  *  none
  *
  *******************************************************************************/
-static void KeyRpt_stdRptProcEvtKeyUp(uint8_t key)
+APP_HOT static void KeyRpt_stdRptProcEvtKeyUp(uint8_t key)
 {
     uint8_t i;
     uint8_t * keyCodes = key_rpts.stdRpt.keyCodes;
@@ -419,7 +601,7 @@ static void KeyRpt_stdRptProcEvtKeyUp(uint8_t key)
  *  FALSE -- no change
  *
  *******************************************************************************/
-static wiced_bool_t KeyRpt_updateBit(uint8_t *buf, uint8_t set, uint8_t bitMask)
+APP_HOT static wiced_bool_t KeyRpt_updateBit(uint8_t *buf, uint8_t set, uint8_t bitMask)
 {
     uint8_t bits = *buf;
 
@@ -447,7 +629,7 @@ static wiced_bool_t KeyRpt_updateBit(uint8_t *buf, uint8_t set, uint8_t bitMask)
  *  none
  *
  *******************************************************************************/
-static void KeyRpt_stdRptProcEvtModKey(uint8_t set, uint8_t translationCode)
+APP_HOT static void KeyRpt_stdRptProcEvtModKey(uint8_t set, uint8_t translationCode)
 {
     // set or reset the bit
     if (KeyRpt_updateBit(&key_rpts.stdRpt.modifierKeys, set, translationCode))
@@ -470,7 +652,7 @@ static void KeyRpt_stdRptProcEvtModKey(uint8_t set, uint8_t translationCode)
  *  none
  *
  *******************************************************************************/
-static void KeyRpt_bitRptProcEvtKey(uint8_t set, uint8_t bitPos)
+APP_HOT static void KeyRpt_bitRptProcEvtKey(uint8_t set, uint8_t bitPos)
 {
     uint8_t idx = bitPos / 8;
     uint8_t bitMask = (1<< (bitPos % 8));
@@ -483,6 +665,58 @@ static void KeyRpt_bitRptProcEvtKey(uint8_t set, uint8_t bitPos)
     }
 }
 
+/********************************************************************************
+ * Function Name: void KeyRpt_ccRptProcEvtKey(uint8_t down, uint8_t ccIdx)
+ ********************************************************************************
+ * Summary: add or remove a usage in the consumer control report
+ *
+ * Parameters:
+ *  down -- TRUE when key is down
+ *  ccIdx -- index in the consumer usage table
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+APP_HOT static void KeyRpt_ccRptProcEvtKey(uint8_t down, uint8_t ccIdx)
+{
+    uint16_t * usage = key_rpts.consumerReport.usage;
+    uint16_t code;
+    uint8_t i;
+
+    if (ccIdx >= CC_MAX)
+    {
+        return;
+    }
+    code = key_ccUsage[ccIdx];
+
+    // find the usage, or the first free slot on key down
+    for (i = 0; i < KEY_NUM_USAGES_IN_CONSUMER_REPORT; i++)
+    {
+        if (usage[i] == code)
+        {
+            break;
+        }
+        if (down && !usage[i])
+        {
+            usage[i] = code;
+            keyRpt.consumer_changed = TRUE;
+            return;
+        }
+    }
+
+    if (!down && (i < KEY_NUM_USAGES_IN_CONSUMER_REPORT))
+    {
+        // remove the usage and keep the array packed
+        for (; i < KEY_NUM_USAGES_IN_CONSUMER_REPORT - 1; i++)
+        {
+            usage[i] = usage[i+1];
+        }
+        usage[i] = 0;
+        keyRpt.consumer_changed = TRUE;
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 /// This function handles func lock key events. Func-lock events are ignored
 /// during recovery and in boot mode. On func-lock down, it performs
@@ -501,7 +735,7 @@ static void KeyRpt_bitRptProcEvtKey(uint8_t set, uint8_t bitPos)
 /// \param keyCode scan code of this key
 /// \param translationCode associated with the func-lock key. Unused
 /////////////////////////////////////////////////////////////////////////////////
-static void KeyRpt_funcLockProcEvtKey(uint8_t upDown)
+APP_HOT static void KeyRpt_funcLockProcEvtKey(uint8_t upDown)
 {
     // Process the event only if we are not in recovery
     if (!app.recoveryInProgress && app.protocol == PROTOCOL_REPORT)
@@ -523,7 +757,7 @@ static void KeyRpt_funcLockProcEvtKey(uint8_t upDown)
 /// \param keyCode scan code of this key
 /// \param slpBitMask location of the sleep bit in the sleep report
 /////////////////////////////////////////////////////////////////////////////////
-static void KeyRpt_slpRptProcEvtKey(uint8_t upDown, uint8_t slpBitMask)
+APP_HOT static void KeyRpt_slpRptProcEvtKey(uint8_t upDown, uint8_t slpBitMask)
 {
     // Check if this is a down key or up key
     if (upDown == KEY_DOWN)
@@ -548,211 +782,1111 @@ static void KeyRpt_slpRptProcEvtKey(uint8_t upDown, uint8_t slpBitMask)
  *  none
  *
  *******************************************************************************/
-static void KeyRpt_procEvtUserDefinedKey(uint8_t down, uint8_t translationCode)
+APP_HOT static void KeyRpt_procEvtUserDefinedKey(uint8_t down, uint8_t translationCode)
 {
 }
 
 /********************************************************************************
- * Function Name: void key_keyEvent(void)
+ * Function Name: void KeyRpt_procEvtKeyType(const KbKeyConfig *cfg, uint8_t keyDown)
  ********************************************************************************
- * Summary: key event handling
+ * Summary: Pass the key event to the processing function of its key type
  *
  * Parameters:
- *  keyCode -- key index
+ *  cfg -- key type and translation value, from the key table or a combo
  *  keyDown -- key up or down
  *
  * Return:
- *  TRUE -- handled correctly
- *  FALSE -- error detected
+ *  none
  *
  *******************************************************************************/
-wiced_bool_t key_procEvtKey(uint8_t keyCode, uint8_t keyDown)
+APP_HOT static void KeyRpt_procEvtKeyType(const KbKeyConfig *cfg, uint8_t keyDown)
 {
-    // Check if we have a valid key
-    if (keyCode < KEY_TABLE_SIZE)
-    {
-        uint8_t keyValue = kbKeyConfig[keyCode].translationValue;
+    uint8_t keyValue = cfg->translationValue;
 
-        // Depending on the key type, call the appropriate function for handling
-        // Pass unknown key types to user function
-        switch(kbKeyConfig[keyCode].type)
-        {
-            case KEY_TYPE_STD:
-                // Processing depends on whether the event is an up or down event
-                keyDown ? KeyRpt_stdRptProcEvtKeyDown(keyValue) : KeyRpt_stdRptProcEvtKeyUp(keyValue);
-                break;
-            case KEY_TYPE_MODIFIER:
-                KeyRpt_stdRptProcEvtModKey(keyDown, keyValue);
-                break;
-            case KEY_TYPE_BIT_MAPPED:
-                KeyRpt_bitRptProcEvtKey(keyDown, keyValue);
-                break;
-            case KEY_TYPE_SLEEP:
-                KeyRpt_slpRptProcEvtKey(keyDown, keyValue);
-                break;
-            case KEY_TYPE_FUNC_LOCK:
-                KeyRpt_funcLockProcEvtKey(keyDown);
-                break;
-            case KEY_TYPE_NONE:
-                // do nothing
-                break;
-            default:
-                KeyRpt_procEvtUserDefinedKey(keyDown, keyValue);
-                break;
-        }
-    }
-    // Check if we have an end of scan cycle event
-    else if (keyCode == END_OF_SCAN_CYCLE)
+    // Depending on the key type, call the appropriate function for handling
+    // Pass unknown key types to user function
+    switch(cfg->type)
     {
-        key_send();
-    }
-    else
-    {
-        // key index is out of range
-        return FALSE;
+        case KEY_TYPE_STD:
+            macro_record(keyDown, FALSE, keyValue);
+            // Processing depends on whether the event is an up or down event
+            keyDown ? KeyRpt_stdRptProcEvtKeyDown(keyValue) : KeyRpt_stdRptProcEvtKeyUp(keyValue);
+            break;
+        case KEY_TYPE_MODIFIER:
+            macro_record(keyDown, TRUE, keyValue);
+            KeyRpt_stdRptProcEvtModKey(keyDown, keyValue);
+            break;
+        case KEY_TYPE_BIT_MAPPED:
+            KeyRpt_bitRptProcEvtKey(keyDown, keyValue);
+            break;
+        case KEY_TYPE_SLEEP:
+            KeyRpt_slpRptProcEvtKey(keyDown, keyValue);
+            break;
+        case KEY_TYPE_FUNC_LOCK:
+            KeyRpt_funcLockProcEvtKey(keyDown);
+            break;
+        case KEY_TYPE_CONSUMER:
+            KeyRpt_ccRptProcEvtKey(keyDown, keyValue);
+            break;
+        case KEY_TYPE_TAP_HOLD:
+            // only the release of a key resolved to hold gets here
+            if (!keyDown)
+            {
+                KeyRpt_stdRptProcEvtModKey(FALSE, key_tapHold[keyValue].holdModifier);
+            }
+            break;
+        case KEY_TYPE_MACRO:
+            macro_key(keyValue, keyDown);
+            break;
+        case KEY_TYPE_MACRO_REC:
+            macro_recordKey(keyDown);
+            break;
+        case KEY_TYPE_HOST:
+#ifdef SUPPORT_DUAL_HOST
+            if (keyDown)
+            {
+                route_select(keyValue);
+            }
+#endif
+            break;
+        case KEY_TYPE_NONE:
+            // do nothing
+            break;
+        default:
+            KeyRpt_procEvtUserDefinedKey(keyDown, keyValue);
+            break;
     }
-    return TRUE;
 }
 
 /********************************************************************************
- * Function Name: void key_send(void)
+ * Function Name: wiced_bool_t KeyRpt_tapHoldExpired(void)
  ********************************************************************************
- * Summary: Send any pending key reports.
+ * Summary: Check if the pending dual role key is held past the tapping term
  *
  * Parameters:
  *  none
  *
  * Return:
- *  none
+ *  TRUE if the tapping term has passed
  *
  *******************************************************************************/
-void key_send()
+APP_HOT STATIC wiced_bool_t KeyRpt_tapHoldExpired(void)
 {
-    if (keyRpt.stdRpt_changed)
-    {
-        hidd_link_send_report(&key_rpts.stdRpt, sizeof(KeyboardStandardReport));
-        keyRpt.stdRpt_changed = FALSE;
-    }
-    if (keyRpt.bitMapped_changed)
-    {
-        hidd_link_send_report(&key_rpts.bitMappedReport, sizeof(KeyboardBitMappedReport));
-        keyRpt.bitMapped_changed = FALSE;
-    }
-    if (keyRpt.funcLock_changed)
-    {
-        hidd_link_send_report(&key_rpts.funcLockReport, sizeof(KeyboardFuncLockReport));
-        keyRpt.funcLock_changed = FALSE;
-    }
-    if (keyRpt.sleep_changed)
-    {
-        hidd_link_send_report(&key_rpts.sleepReport, sizeof(KeyboardSleepReport));
-        keyRpt.sleep_changed = FALSE;
-    }
-    if (keyRpt.bitMapped_changed)
-    {
-        hidd_link_send_report(&key_rpts.scrollReport, sizeof(KeyboardMotionReport));
-        keyRpt.bitMapped_changed = FALSE;
-    }
-#ifdef SUPPORT_CODE_ENTRY
-    if (keyRpt.pin_changed)
-    {
-        hidd_link_send_report(&key_rpts.pinReport, sizeof(KeyboardPinEntryReport));
-        keyRpt.pin_changed = FALSE;
-    }
-#endif
+    return wiced_hidd_get_bt_clocks_since(keyTapHold.startBtClk) >= MS_TO_BT_CLOCKS(KEY_TAP_HOLD_TERM_MS);
 }
 
-#ifdef SUPPORT_CODE_ENTRY
-void key_pinReport(uint8_t code)
+/********************************************************************************
+ * Function Name: wiced_bool_t KeyRpt_tapHoldHeldBack(uint8_t keyCode)
+ ********************************************************************************
+ * Summary: Check if the key down event of keyCode is held back by the resolver
+ *
+ * Parameters:
+ *  keyCode -- key index
+ *
+ * Return:
+ *  TRUE if the key went down while the dual role key is pending
+ *
+ *******************************************************************************/
+APP_HOT STATIC wiced_bool_t KeyRpt_tapHoldHeldBack(uint8_t keyCode)
 {
-    key_rpts.pinReport.reportCode = code;
-    keyRpt.pin_changed = TRUE;
+    uint8_t i;
+
+    for (i = 0; i < keyTapHold.count; i++)
+    {
+        if (keyTapHold.buf[i].keyDown && (keyTapHold.buf[i].keyCode == keyCode))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
 }
-#endif
+
 /********************************************************************************
- * Function Name: void key_clear(wiced_bool_t sendRpt)
+ * Function Name: void KeyRpt_tapHoldReplay(void)
  ********************************************************************************
- * Summary: Clear all reports to default value
+ * Summary: Replay the key events held back by a resolved dual role key. The
+ *          replay stops at a report boundary while the reports before it are
+ *          still waiting for the transport, the events after it would merge
+ *          into them. key_send() picks it up again once they are sent.
  *
  * Parameters:
- *  sendRpt -- When TRUE, after clear, send standard report (to indicate all keys are up)
+ *  none
  *
  * Return:
  *  none
  *
  *******************************************************************************/
-void key_clear(wiced_bool_t sendRpt)
+APP_HOT STATIC void KeyRpt_tapHoldReplay(void)
 {
-    // clear report data
-    memset(&key_rpts.stdRpt.modifierKeys, 0, sizeof(KeyboardStandardReport)-1);
-    memset(&key_rpts.bitMappedReport.bitMappedKeys, 0, sizeof(KeyboardBitMappedReport)-1);
-    memset(&key_rpts.scrollReport.motionAxis0, 0, sizeof(KeyboardMotionReport)-1);
-#ifdef SUPPORT_CODE_ENTRY
-    memset(&key_rpts.pinReport.reportCode, 0, sizeof(KeyboardPinEntryReport)-1);
-#endif
-    // mark if we need to generate report
-    keyRpt.stdRpt_changed = keyRpt.bitMapped_changed = sendRpt;
+    key_evt_t evt;
 
-    key_send();
+    // a resolve while replaying only adds events, the running replay takes them
+    if (keyTapHold.replaying)
+    {
+        return;
+    }
+    keyTapHold.replaying = TRUE;
+
+    for (;;)
+    {
+        if (keyTapHold.boundary)
+        {
+            key_send();
+            if (KeyRpt_reportPending())
+            {
+                break;
+            }
+            keyTapHold.boundary = FALSE;
+        }
+
+        if (keyTapHold.tapRelease)
+        {
+            KeyRpt_stdRptProcEvtKeyUp(keyTapHold.tapRelease);
+            keyTapHold.tapRelease = 0;
+        }
+        else if (keyTapHold.replayCount)
+        {
+            evt = keyTapHold.replay[0];
+            keyTapHold.replayCount--;
+            memmove(keyTapHold.replay, &keyTapHold.replay[1], keyTapHold.replayCount * sizeof(key_evt_t));
+
+            // held back by a new pending key, the cycle end is not a boundary yet
+            if ((evt.keyCode == END_OF_SCAN_CYCLE) && !keyTapHold.count)
+            {
+                keyTapHold.boundary = TRUE;
+            }
+            else
+            {
+                KeyRpt_tapHoldStage(evt.keyCode, evt.keyDown);
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    keyTapHold.replaying = FALSE;
 }
 
 /********************************************************************************
- * Function Name: void key_sendRollover()
+ * Function Name: void KeyRpt_tapHoldResolve(wiced_bool_t hold, const key_evt_t *next)
  ********************************************************************************
- * Summary: Send a rollover packet
+ * Summary: Resolve the pending dual role key and replay the key events held back
+ *          while it was pending, in order. A tap press is sent in its own report
+ *          before its release. The events go ahead of what is left of an earlier
+ *          replay, replaying them may start another dual role key.
  *
  * Parameters:
- *  none
+ *  hold -- TRUE to resolve to the hold modifier, FALSE to send a tap
+ *  next -- the key event that resolved the key, replayed after the held back
+ *          ones, or NULL
  *
  * Return:
  *  none
  *
  *******************************************************************************/
-void key_sendRollover()
+APP_HOT STATIC void KeyRpt_tapHoldResolve(wiced_bool_t hold, const key_evt_t *next)
 {
-    KeyboardStandardReport  rolloverRpt = {RPT_ID_IN_STD_KEY, 0, 0, {CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER}};
-    // Tx rollover report
-    WICED_BT_TRACE("\nRollOverRpt");
-    hidd_link_send_report(&rolloverRpt, sizeof(KeyboardStandardReport));
+    const KeyTapHoldConfig *cfg = &key_tapHold[kbKeyConfig[keyTapHold.keyCode].translationValue];
+    key_evt_t evt[KEY_TAP_HOLD_BUF_SIZE + 2];
+    uint8_t count = keyTapHold.count;
+
+    memcpy(evt, keyTapHold.buf, count * sizeof(key_evt_t));
+    if (next)
+    {
+        // the modifier goes out on its own before the hold is released
+        if (next->keyCode == keyTapHold.keyCode)
+        {
+            evt[count].keyCode = END_OF_SCAN_CYCLE;
+            evt[count++].keyDown = FALSE;
+        }
+        evt[count++] = *next;
+    }
+    keyTapHold.pending = FALSE;
+    keyTapHold.count = 0;
+
+    // a replay only grows by the cycle end added above, each time it takes one of its own events
+    memmove(&keyTapHold.replay[count], keyTapHold.replay, keyTapHold.replayCount * sizeof(key_evt_t));
+    memcpy(keyTapHold.replay, evt, count * sizeof(key_evt_t));
+    keyTapHold.replayCount += count;
+
+    if (hold)
+    {
+        KeyRpt_stdRptProcEvtModKey(TRUE, cfg->holdModifier);
+    }
+    else
+    {
+        // the press must reach the host in its own report, or the tap is lost
+        KeyRpt_stdRptProcEvtKeyDown(cfg->tapUsage);
+        keyTapHold.tapRelease = cfg->tapUsage;
+        keyTapHold.boundary = TRUE;
+    }
+
+    KeyRpt_tapHoldReplay();
 }
 
 /********************************************************************************
- * Function Name: void key_setReport()
+ * Function Name: void KeyRpt_tapHoldProcEvtKey(uint8_t keyCode, uint8_t keyDown)
  ********************************************************************************
- * Summary: handle HID setReport for keyboard
+ * Summary: Dual role key resolver. A dual role key going down becomes pending.
+ *          While it is pending, other key events are held back until it resolves:
+ *            - released within the tapping term: tap
+ *            - held past the tapping term: hold
+ *            - another key pressed and released within the term: hold (permissive)
+ *            - another key pressed within the term: hold, if KEY_TAP_HOLD_ON_INTERRUPT
+ *          Releasing a key pressed before the dual role key is not held back.
+ *          END_OF_SCAN_CYCLE is held back as well so replay keeps the report boundaries.
  *
  * Parameters:
- *  reportType -- report type (defined in wiced_hidd_report_type_e)
- *  reportId   -- Report ID
- *  payload    -- data pointer
- *  payloadSize -- data length
+ *  keyCode -- key index or END_OF_SCAN_CYCLE
+ *  keyDown -- key up or down
  *
  * Return:
- *  TRUE -- if handled
+ *  none
  *
  *******************************************************************************/
-wiced_bool_t key_setReport(wiced_hidd_report_type_t reportType,
-                     uint8_t reportId,
-                     void *payload,
-                     uint16_t payloadSize)
+APP_HOT STATIC void KeyRpt_tapHoldProcEvtKey(uint8_t keyCode, uint8_t keyDown)
 {
-    if (reportType == WICED_HID_REPORT_TYPE_OUTPUT)
+    if (!keyTapHold.pending)
+    {
+        if (keyDown)
+        {
+            keyTapHold.pending = TRUE;
+            keyTapHold.keyCode = keyCode;
+            keyTapHold.startBtClk = wiced_hidd_get_current_native_bt_clocks();
+        }
+        else
+        {
+            KeyRpt_procEvtKeyType(&kbKeyConfig[keyCode], keyDown);
+        }
+        return;
+    }
+
+    if (keyCode == keyTapHold.keyCode)
     {
-        // Pass to handler based on report ID. Ensure that report ID is in the payload
-        if (payloadSize >= 1)
+        if (!keyDown)
         {
-            // Demux on report ID
-            if(reportId == RPT_ID_OUT_KB_LED)
+            if (KeyRpt_tapHoldExpired())
             {
-                key_rpts.ledReport.ledStates = *(uint8_t *) payload;
-//                WICED_BT_TRACE("\nKB LED report %d", key_rpts.ledReport.ledStates);
-#if LED_SUPPORT
-                key_rpts.ledReport.ledStates & 0x2 ? hidd_led_on(LED_CAPS) : hidd_led_off(LED_CAPS);
-#endif
-                return TRUE;
+                // the poll has not caught the term yet, the release is replayed after the modifier
+                key_evt_t evt = {keyCode, keyDown};
+
+                KeyRpt_tapHoldResolve(TRUE, &evt);
+            }
+            else
+            {
+                KeyRpt_tapHoldResolve(FALSE, NULL);
             }
         }
+        return;
+    }
+
+    if (keyCode == END_OF_SCAN_CYCLE)
+    {
+        // nothing to separate unless a key event is held back since the last one
+        if (keyTapHold.count && (keyTapHold.buf[keyTapHold.count-1].keyCode != END_OF_SCAN_CYCLE) &&
+            (keyTapHold.count < KEY_TAP_HOLD_BUF_SIZE))
+        {
+            keyTapHold.buf[keyTapHold.count].keyCode = keyCode;
+            keyTapHold.buf[keyTapHold.count++].keyDown = keyDown;
+        }
+        else if (!keyTapHold.count)
+        {
+            key_send();
+        }
+        return;
+    }
+
+    if (!keyDown && !KeyRpt_tapHoldHeldBack(keyCode))
+    {
+        // released key went down before the dual role key, no need to wait
+        KeyRpt_procEvtKeyType(&kbKeyConfig[keyCode], keyDown);
+        return;
+    }
+
+    if (KeyRpt_tapHoldExpired() || (keyTapHold.count == KEY_TAP_HOLD_BUF_SIZE))
+    {
+        key_evt_t evt = {keyCode, keyDown};
+
+        KeyRpt_tapHoldResolve(TRUE, &evt);
+        return;
+    }
+
+    keyTapHold.buf[keyTapHold.count].keyCode = keyCode;
+    keyTapHold.buf[keyTapHold.count++].keyDown = keyDown;
+
+    if (keyDown ? KEY_TAP_HOLD_ON_INTERRUPT : KEY_TAP_HOLD_PERMISSIVE)
+    {
+        KeyRpt_tapHoldResolve(TRUE, NULL);
+    }
+}
+
+/********************************************************************************
+ * Function Name: void KeyRpt_tapHoldStage(uint8_t keyCode, uint8_t keyDown)
+ ********************************************************************************
+ * Summary: Key event handling after the combo engine. Dual role keys, and any
+ *          key while one is pending, go through the tap-hold resolver.
+ *
+ * Parameters:
+ *  keyCode -- key index or END_OF_SCAN_CYCLE
+ *  keyDown -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+APP_HOT static void KeyRpt_tapHoldStage(uint8_t keyCode, uint8_t keyDown)
+{
+    if (keyTapHold.pending)
+    {
+        KeyRpt_tapHoldProcEvtKey(keyCode, keyDown);
+    }
+    else if (keyCode == END_OF_SCAN_CYCLE)
+    {
+        key_send();
+    }
+    else if (kbKeyConfig[keyCode].type == KEY_TYPE_TAP_HOLD)
+    {
+        KeyRpt_tapHoldProcEvtKey(keyCode, keyDown);
+    }
+    else
+    {
+        KeyRpt_procEvtKeyType(&kbKeyConfig[keyCode], keyDown);
+    }
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t KeyRpt_comboExpired(void)
+ ********************************************************************************
+ * Summary: Check if the combo window of the held back keys has passed
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if the combo window has passed
+ *
+ *******************************************************************************/
+APP_HOT STATIC wiced_bool_t KeyRpt_comboExpired(void)
+{
+    return wiced_hidd_get_bt_clocks_since(keyCombo.startBtClk) >= MS_TO_BT_CLOCKS(KEY_COMBO_TERM_MS);
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t KeyRpt_comboMatch(uint8_t combo)
+ ********************************************************************************
+ * Summary: Check if all keys of the combo are held back
+ *
+ * Parameters:
+ *  combo -- combo index
+ *
+ * Return:
+ *  TRUE if the combo matches the held back keys
+ *
+ *******************************************************************************/
+APP_HOT STATIC wiced_bool_t KeyRpt_comboMatch(uint8_t combo)
+{
+    uint8_t i, key;
+
+    for (i = 0; i < key_combo[combo].keyCount; i++)
+    {
+        key = key_combo[combo].keys[i];
+        if (!(keyCombo.held[key >> 3] & (1 << (key & 7))))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/********************************************************************************
+ * Function Name: void KeyRpt_comboSettle(void)
+ ********************************************************************************
+ * Summary: End the combo window. If a candidate has all its keys held back it
+ *          becomes the active combo, otherwise the held back keys go on in the
+ *          order they were pressed.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+APP_HOT STATIC void KeyRpt_comboSettle(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < COMBO_MAX; i++)
+    {
+        if ((keyCombo.candidates & (1 << i)) && KeyRpt_comboMatch(i))
+        {
+            break;
+        }
+    }
+
+    if (i < COMBO_MAX)
+    {
+        keyCombo.active = i;
+        keyCombo.activeKeys = (1 << key_combo[i].keyCount) - 1;
+        KeyRpt_procEvtKeyType(&key_combo[i].out, TRUE);
+    }
+    else
+    {
+        for (i = 0; i < keyCombo.count; i++)
+        {
+            KeyRpt_tapHoldStage(keyCombo.buf[i], TRUE);
+        }
+    }
+
+    keyCombo.count = 0;
+    keyCombo.candidates = 0;
+    memset(keyCombo.held, 0, sizeof(keyCombo.held));
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t KeyRpt_comboProcEvtKey(uint8_t keyCode, uint8_t keyDown)
+ ********************************************************************************
+ * Summary: Combo engine. A key down that can still complete a combo is held back
+ *          with the keys before it. The combo fires as soon as the held back keys
+ *          match it and no larger candidate remains, or when the combo window ends.
+ *          Any event that rules out every candidate settles the window first.
+ *          The combo key is released when the first of its keys goes up, the
+ *          releases of its keys are consumed.
+ *
+ * Parameters:
+ *  keyCode -- key index
+ *  keyDown -- key up or down
+ *
+ * Return:
+ *  TRUE if the event is consumed, FALSE if it must be processed further
+ *
+ *******************************************************************************/
+APP_HOT STATIC wiced_bool_t KeyRpt_comboProcEvtKey(uint8_t keyCode, uint8_t keyDown)
+{
+    uint8_t candidates;
+    uint8_t i;
+
+    if (keyCombo.activeKeys && (key_comboMember[keyCode] & (1 << keyCombo.active)))
+    {
+        for (i = 0; key_combo[keyCombo.active].keys[i] != keyCode; i++);
+
+        if (!keyDown && (keyCombo.activeKeys & (1 << i)))
+        {
+            if (keyCombo.activeKeys == (1 << key_combo[keyCombo.active].keyCount) - 1)
+            {
+                KeyRpt_procEvtKeyType(&key_combo[keyCombo.active].out, FALSE);
+            }
+            keyCombo.activeKeys &= ~(1 << i);
+            return TRUE;
+        }
+    }
+
+    if (keyCombo.count && KeyRpt_comboExpired())
+    {
+        KeyRpt_comboSettle();
+    }
+
+    // no new combo starts until the active one is fully released
+    candidates = (keyDown && !keyCombo.activeKeys) ? key_comboMember[keyCode] : 0;
+    if (keyCombo.count)
+    {
+        candidates &= keyCombo.candidates;
+    }
+
+    if (candidates)
+    {
+        if (!keyCombo.count)
+        {
+            keyCombo.startBtClk = wiced_hidd_get_current_native_bt_clocks();
+        }
+        keyCombo.buf[keyCombo.count++] = keyCode;
+        keyCombo.held[keyCode >> 3] |= 1 << (keyCode & 7);
+        keyCombo.candidates = candidates;
+
+        // a single candidate with all its keys down cannot grow any further
+        for (i = 0; i < COMBO_MAX; i++)
+        {
+            if ((candidates == (1 << i)) && KeyRpt_comboMatch(i))
+            {
+                KeyRpt_comboSettle();
+                break;
+            }
+        }
+        return TRUE;
+    }
+
+    if (!keyCombo.count)
+    {
+        return FALSE;
+    }
+
+    // no combo can match any more, settle and take the event again with nothing held back
+    KeyRpt_comboSettle();
+    return KeyRpt_comboProcEvtKey(keyCode, keyDown);
+}
+
+/********************************************************************************
+ * Function Name: void key_keyEvent(void)
+ ********************************************************************************
+ * Summary: key event handling
+ *
+ * Parameters:
+ *  keyCode -- key index
+ *  keyDown -- key up or down
+ *
+ * Return:
+ *  TRUE -- handled correctly
+ *  FALSE -- error detected
+ *
+ *******************************************************************************/
+APP_HOT wiced_bool_t key_procEvtKey(uint8_t keyCode, uint8_t keyDown)
+{
+    // Check if we have a valid key
+    if (keyCode < KEY_TABLE_SIZE)
+    {
+        key_statsCount(keyCode, keyDown);
+
+        // Keys that are not in any combo skip the combo engine unless keys are held back
+        if (!(key_comboMember[keyCode] || keyCombo.count) || !KeyRpt_comboProcEvtKey(keyCode, keyDown))
+        {
+            KeyRpt_tapHoldStage(keyCode, keyDown);
+        }
+    }
+    // Check if we have an end of scan cycle event
+    else if (keyCode == END_OF_SCAN_CYCLE)
+    {
+        KeyRpt_tapHoldStage(keyCode, keyDown);
+    }
+    else
+    {
+        // key index is out of range
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/********************************************************************************
+ * Function Name: void key_play(uint8_t type, uint8_t value, uint8_t keyDown)
+ ********************************************************************************
+ * Summary: Process a key event that does not come from the key matrix and send
+ *          the reports it changed. Used by the macro playback.
+ *
+ * Parameters:
+ *  type -- key type
+ *  value -- translation value
+ *  keyDown -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_play(uint8_t type, uint8_t value, uint8_t keyDown)
+{
+    KbKeyConfig cfg = {type, value};
+
+    KeyRpt_procEvtKeyType(&cfg, keyDown);
+    key_send();
+}
+
+/********************************************************************************
+ * Function Name: void key_tapHoldPoll(void)
+ ********************************************************************************
+ * Summary: Resolve the pending dual role key to hold once the tapping term has
+ *          passed, without waiting for the next key event.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_tapHoldPoll(void)
+{
+    // the modifier must not join a report still waiting for the transport
+    if (key_sendPending() || !route_txReady())
+    {
+        return;
+    }
+
+    if (keyTapHold.pending && KeyRpt_tapHoldExpired())
+    {
+        KeyRpt_tapHoldResolve(TRUE, NULL);
+        key_send();
+    }
+}
+
+/********************************************************************************
+ * Function Name: void key_comboPoll(void)
+ ********************************************************************************
+ * Summary: Settle the held back combo keys once the combo window has passed,
+ *          without waiting for the next key event.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_comboPoll(void)
+{
+    // the settled keys must not join a report still waiting for the transport
+    if (key_sendPending() || !route_txReady())
+    {
+        return;
+    }
+
+    if (keyCombo.count && KeyRpt_comboExpired())
+    {
+        KeyRpt_comboSettle();
+        key_send();
+    }
+}
+
+/********************************************************************************
+ * Function Name: void key_configInit(void)
+ ********************************************************************************
+ * Summary: Load the built-in keymap into the key table and build the per key
+ *          combo membership masks from the combo table
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_configInit(void)
+{
+#if USE_COMBO
+    uint8_t i, k;
+#endif
+
+    memcpy(kbKeyConfig, key_defaultConfig, sizeof(kbKeyConfig));
+
+    memset(key_comboMember, 0, sizeof(key_comboMember));
+#if USE_COMBO
+    for (i = 0; i < COMBO_MAX; i++)
+    {
+        for (k = 0; k < key_combo[i].keyCount; k++)
+        {
+            key_comboMember[key_combo[i].keys[k]] |= 1 << i;
+        }
+    }
+#endif
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t key_keymapValid(const KbKeyConfig *map, uint16_t count)
+ ********************************************************************************
+ * Summary: Check a keymap before it replaces the key table
+ *
+ * Parameters:
+ *  map -- keymap, one entry per key index
+ *  count -- number of entries in map
+ *
+ * Return:
+ *  TRUE if every entry can be processed by this firmware
+ *
+ *******************************************************************************/
+wiced_bool_t key_keymapValid(const KbKeyConfig *map, uint16_t count)
+{
+    uint16_t i;
+
+    if (count != KEY_TABLE_SIZE)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        switch (map[i].type)
+        {
+            case KEY_TYPE_BIT_MAPPED:
+                if (map[i].translationValue >= BIT_MAPPED_MAX)
+                {
+                    return FALSE;
+                }
+                break;
+            case KEY_TYPE_CONSUMER:
+                if (map[i].translationValue >= CC_MAX)
+                {
+                    return FALSE;
+                }
+                break;
+            case KEY_TYPE_TAP_HOLD:
+                if (map[i].translationValue >= TH_MAX)
+                {
+                    return FALSE;
+                }
+                break;
+            default:
+                if (map[i].type >= KEY_TYPE_MAX)
+                {
+                    return FALSE;
+                }
+                break;
+        }
+    }
+    return TRUE;
+}
+
+/********************************************************************************
+ * Function Name: void key_setKeymap(const KbKeyConfig *map, wiced_bool_t sendRpt)
+ ********************************************************************************
+ * Summary: Replace the key table. Keys down are released first, their up events
+ *          would not match the new table.
+ *
+ * Parameters:
+ *  map -- keymap checked with key_keymapValid, NULL for the built-in keymap
+ *  sendRpt -- TRUE to send the released reports
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_setKeymap(const KbKeyConfig *map, wiced_bool_t sendRpt)
+{
+    memcpy(kbKeyConfig, map ? map : key_defaultConfig, sizeof(kbKeyConfig));
+    key_clear(sendRpt);
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t KeyRpt_commit(void * snapshot, void * working, uint16_t len)
+ ********************************************************************************
+ * Summary: Copy a report from the working copy to the snapshot and send it. The
+ *          transport room is checked first, so a report that cannot go leaves
+ *          the snapshot as it is and stays pending.
+ *
+ * Parameters:
+ *  snapshot -- report in key_snapshot
+ *  working -- same report in key_rpts
+ *  len -- report length
+ *
+ * Return:
+ *  TRUE if the report is sent
+ *
+ *******************************************************************************/
+APP_HOT STATIC wiced_bool_t KeyRpt_commit(void * snapshot, void * working, uint16_t len)
+{
+    if (!route_txReady())
+    {
+        return FALSE;
+    }
+    memcpy(snapshot, working, len);
+    app_sendReport(snapshot, len);
+    return TRUE;
+}
+
+/********************************************************************************
+ * Function Name: void key_send(void)
+ ********************************************************************************
+ * Summary: Send any pending key reports. Stops at the first report the
+ *          transport has no room for, the rest stay pending in order. Once
+ *          all are sent, a dual role key replay stopped on them goes on.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_send()
+{
+    if (keyRpt.stdRpt_changed)
+    {
+        if (!KeyRpt_commit(&key_snapshot.stdRpt, &key_rpts.stdRpt, sizeof(KeyboardStandardReport)))
+        {
+            return;
+        }
+        keyRpt.stdRpt_changed = FALSE;
+    }
+    if (keyRpt.bitMapped_changed)
+    {
+        if (!KeyRpt_commit(&key_snapshot.bitMappedReport, &key_rpts.bitMappedReport, sizeof(KeyboardBitMappedReport)))
+        {
+            return;
+        }
+        keyRpt.bitMapped_changed = FALSE;
+    }
+    if (keyRpt.funcLock_changed)
+    {
+        if (!KeyRpt_commit(&key_snapshot.funcLockReport, &key_rpts.funcLockReport, sizeof(KeyboardFuncLockReport)))
+        {
+            return;
+        }
+        keyRpt.funcLock_changed = FALSE;
+    }
+    if (keyRpt.sleep_changed)
+    {
+        if (!KeyRpt_commit(&key_snapshot.sleepReport, &key_rpts.sleepReport, sizeof(KeyboardSleepReport)))
+        {
+            return;
+        }
+        keyRpt.sleep_changed = FALSE;
+    }
+    if (keyRpt.scroll_changed)
+    {
+        if (!KeyRpt_commit(&key_snapshot.scrollReport, &key_rpts.scrollReport, sizeof(KeyboardMotionReport)))
+        {
+            return;
+        }
+        keyRpt.scroll_changed = FALSE;
+    }
+    if (keyRpt.consumer_changed)
+    {
+        if (!KeyRpt_commit(&key_snapshot.consumerReport, &key_rpts.consumerReport, sizeof(KeyboardConsumerReport)))
+        {
+            return;
+        }
+        keyRpt.consumer_changed = FALSE;
+    }
+#ifdef SUPPORT_CODE_ENTRY
+    if (keyRpt.pin_changed)
+    {
+        if (!KeyRpt_commit(&key_snapshot.pinReport, &key_rpts.pinReport, sizeof(KeyboardPinEntryReport)))
+        {
+            return;
+        }
+        keyRpt.pin_changed = FALSE;
+    }
+#endif
+
+    if (keyTapHold.boundary || keyTapHold.tapRelease || keyTapHold.replayCount)
+    {
+        KeyRpt_tapHoldReplay();
+    }
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t KeyRpt_reportPending(void)
+ ********************************************************************************
+ * Summary: Check if key reports are waiting for room in the transport
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if a report is pending
+ *
+ *******************************************************************************/
+static wiced_bool_t KeyRpt_reportPending(void)
+{
+    return keyRpt.stdRpt_changed || keyRpt.bitMapped_changed || keyRpt.funcLock_changed ||
+           keyRpt.sleep_changed || keyRpt.scroll_changed || keyRpt.consumer_changed
+#ifdef SUPPORT_CODE_ENTRY
+           || keyRpt.pin_changed
+#endif
+           ;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t key_sendPending(void)
+ ********************************************************************************
+ * Summary: Check if key reports, or held back key events replayed behind them,
+ *          are waiting for room in the transport
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if a report or a key event is pending
+ *
+ *******************************************************************************/
+wiced_bool_t key_sendPending(void)
+{
+    return KeyRpt_reportPending() || keyTapHold.tapRelease || keyTapHold.replayCount;
+}
+
+#ifdef SUPPORT_SCROLL
+/********************************************************************************
+ * Function Name: void key_scrollMotion(int16_t delta)
+ ********************************************************************************
+ * Summary: Add scroll motion to be sent. Motion is accumulated until the next
+ *          scroll report and saturates at the int16 range.
+ *
+ * Parameters:
+ *  delta -- scroll motion since the last call
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_scrollMotion(int16_t delta)
+{
+    int32_t sum = keyRpt.scrollAccum + delta;
+
+    if (sum > INT16_MAX)
+    {
+        sum = INT16_MAX;
+    }
+    else if (sum < INT16_MIN)
+    {
+        sum = INT16_MIN;
+    }
+    keyRpt.scrollAccum = (int16_t) sum;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t key_scrollPending(void)
+ ********************************************************************************
+ * Summary: Check if there is scroll motion not sent yet
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if scroll motion is pending
+ *
+ *******************************************************************************/
+wiced_bool_t key_scrollPending(void)
+{
+    return keyRpt.scrollAccum != 0;
+}
+
+/********************************************************************************
+ * Function Name: void key_scrollSend(void)
+ ********************************************************************************
+ * Summary: Send the accumulated scroll motion in one scroll report. Called from
+ *          the connection event poll only, not from the keyscan polls in
+ *          between, so scrolling never takes more than one report per event. Nothing is sent while the ACL pool
+ *          is busy; the motion keeps accumulating and goes out in a later event.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_scrollSend(void)
+{
+    // a scroll report still pending holds motion not sent yet
+    if (keyRpt.scrollAccum && !keyRpt.scroll_changed && !app.recoveryInProgress && route_txReady())
+    {
+        key_rpts.scrollReport.motionAxis0 = keyRpt.scrollAccum;
+        keyRpt.scrollAccum = 0;
+        keyRpt.scroll_changed = TRUE;
+        key_send();
+    }
+}
+#endif
+
+#ifdef SUPPORT_CODE_ENTRY
+void key_pinReport(uint8_t code)
+{
+    key_rpts.pinReport.reportCode = code;
+    keyRpt.pin_changed = TRUE;
+}
+#endif
+/********************************************************************************
+ * Function Name: void key_clear(wiced_bool_t sendRpt)
+ ********************************************************************************
+ * Summary: Clear all reports to default value
+ *
+ * Parameters:
+ *  sendRpt -- When TRUE, after clear, send standard report (to indicate all keys are up)
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_clear(wiced_bool_t sendRpt)
+{
+    // clear report data
+    memset(&key_rpts.stdRpt.modifierKeys, 0, sizeof(KeyboardStandardReport)-1);
+    memset(&key_rpts.bitMappedReport.bitMappedKeys, 0, sizeof(KeyboardBitMappedReport)-1);
+    memset(&key_rpts.scrollReport.motionAxis0, 0, sizeof(KeyboardMotionReport)-1);
+    memset(&key_rpts.consumerReport.usage, 0, sizeof(KeyboardConsumerReport)-1);
+#ifdef SUPPORT_SCROLL
+    keyRpt.scrollAccum = 0;
+    keyRpt.scroll_changed = FALSE;
+#endif
+    // drop the pending dual role key and the events held back with it
+    keyTapHold.pending = FALSE;
+    keyTapHold.count = 0;
+    keyTapHold.tapRelease = 0;
+    keyTapHold.boundary = FALSE;
+    keyTapHold.replayCount = 0;
+    macro_stop();
+    // same for the combo engine
+    keyCombo.count = 0;
+    keyCombo.candidates = 0;
+    keyCombo.activeKeys = 0;
+    memset(keyCombo.held, 0, sizeof(keyCombo.held));
+#ifdef SUPPORT_CODE_ENTRY
+    memset(&key_rpts.pinReport.reportCode, 0, sizeof(KeyboardPinEntryReport)-1);
+#endif
+    // mark if we need to generate report
+    keyRpt.stdRpt_changed = keyRpt.bitMapped_changed = keyRpt.consumer_changed = sendRpt;
+
+    key_send();
+
+    if (!sendRpt)
+    {
+        // nothing is sent, but host reads should not return the old keys either
+        memcpy(&key_snapshot.stdRpt, &key_rpts.stdRpt, sizeof(KeyboardStandardReport));
+        memcpy(&key_snapshot.bitMappedReport, &key_rpts.bitMappedReport, sizeof(KeyboardBitMappedReport));
+        memcpy(&key_snapshot.funcLockReport, &key_rpts.funcLockReport, sizeof(KeyboardFuncLockReport));
+        memcpy(&key_snapshot.sleepReport, &key_rpts.sleepReport, sizeof(KeyboardSleepReport));
+        memcpy(&key_snapshot.scrollReport, &key_rpts.scrollReport, sizeof(KeyboardMotionReport));
+        memcpy(&key_snapshot.consumerReport, &key_rpts.consumerReport, sizeof(KeyboardConsumerReport));
+    }
+}
+
+/********************************************************************************
+ * Function Name: void key_sendRollover()
+ ********************************************************************************
+ * Summary: Send a rollover packet
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_sendRollover()
+{
+    KeyboardStandardReport  rolloverRpt = {RPT_ID_IN_STD_KEY, 0, 0, {CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER, CODE_ROLLOVER}};
+    // Tx rollover report
+    WICED_BT_TRACE("\nRollOverRpt");
+    app_sendReport(&rolloverRpt, sizeof(KeyboardStandardReport));
+}
+
+/********************************************************************************
+ * Function Name: void key_setReport()
+ ********************************************************************************
+ * Summary: handle HID setReport for keyboard
+ *
+ * Parameters:
+ *  reportType -- report type (defined in wiced_hidd_report_type_e)
+ *  reportId   -- Report ID
+ *  payload    -- data pointer
+ *  payloadSize -- data length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_setReport(wiced_hidd_report_type_t reportType,
+                     uint8_t reportId,
+                     void *payload,
+                     uint16_t payloadSize)
+{
+    // only the keyboard LED output report is registered to this handler
+    if ((reportType == WICED_HID_REPORT_TYPE_OUTPUT) && (reportId == RPT_ID_OUT_KB_LED) && (payloadSize >= 1))
+    {
+        key_rpts.ledReport.ledStates = *(uint8_t *) payload;
+//        WICED_BT_TRACE("\nKB LED report %d", key_rpts.ledReport.ledStates);
+#if LED_SUPPORT
+        key_rpts.ledReport.ledStates & 0x2 ? hidd_led_on(LED_CAPS) : hidd_led_off(LED_CAPS);
+        bat_led_state(LED_CAPS, key_rpts.ledReport.ledStates & 0x2 ? 100 : 0);
+#endif
     }
-    return FALSE;
 }
 #endif // SUPPORT_KEY_REPORT
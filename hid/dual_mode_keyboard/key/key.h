@@ -54,6 +54,9 @@
 #define KEY_NUM_BYTES_IN_BIT_MAPPED_REPORT   11
 #define KEY_NUM_BYTES_IN_USER_DEFINED_REPORT   8
 
+/// Maximum number of usages reported at the same time in the consumer control report
+#define KEY_NUM_USAGES_IN_CONSUMER_REPORT   3
+
 /// Func lock key state
 typedef enum
 {
@@ -87,6 +90,23 @@ enum KeyType
     /// The function lock key
     KEY_TYPE_FUNC_LOCK,
 
+    /// Represents a key in the consumer control report. The associated translation value
+    /// is the index of its usage in the consumer usage table
+    KEY_TYPE_CONSUMER,
+
+    /// Represents a dual role key, a standard key when tapped and a modifier when held.
+    /// The associated translation value is the index of its entry in the tap-hold table
+    KEY_TYPE_TAP_HOLD,
+
+    /// Plays or selects for recording a macro. The associated translation value is the macro slot
+    KEY_TYPE_MACRO,
+
+    /// Starts and stops macro recording
+    KEY_TYPE_MACRO_REC,
+
+    /// Sends the reports to another host. The associated translation value is the transport
+    KEY_TYPE_HOST,
+
     /// A user defined key. Interpretation is provided by user code
     KEY_TYPE_USER_0,
 
@@ -124,6 +144,16 @@ typedef PACKED struct
     uint8_t    bitMappedKeys[KEY_NUM_BYTES_IN_BIT_MAPPED_REPORT];
 }KeyboardBitMappedReport;
 
+/// Consumer control report structure
+typedef PACKED struct
+{
+    /// Set to the value specified in the config record.
+    uint8_t    reportID;
+
+    /// Usages of the pressed keys, 0 for unused slots
+    uint16_t   usage[KEY_NUM_USAGES_IN_CONSUMER_REPORT];
+}KeyboardConsumerReport;
+
 /// Pin entry report structure
 typedef PACKED struct
 {
@@ -201,6 +231,9 @@ typedef struct {
     /// scroll report
     KeyboardMotionReport    scrollReport;
 
+    /// consumer control report
+    KeyboardConsumerReport  consumerReport;
+
 #ifdef SUPPORT_CODE_ENTRY
     /// pin report
     KeyboardPinEntryReport  pinReport;
@@ -223,7 +256,8 @@ typedef PACKED struct
     uint8_t    translationValue;
 }KbKeyConfig;
 
-extern key_input_rpt_t key_rpts;
+extern key_input_rpt_t key_rpts;       // working copy, updated by the key processors
+extern key_input_rpt_t key_snapshot;   // last committed input reports, read by GET_REPORT and GATT
 extern KbKeyConfig kbKeyConfig[];
 
 #ifdef SUPPORT_KEY_REPORT
@@ -273,6 +307,20 @@ wiced_bool_t key_procEvtKey(uint8_t keyCode, uint8_t keyDown);
  *******************************************************************************/
 void key_send();
 
+/********************************************************************************
+ * Function Name: wiced_bool_t key_sendPending(void)
+ ********************************************************************************
+ * Summary: Check if key reports are waiting for room in the transport
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if a report is pending
+ *
+ *******************************************************************************/
+wiced_bool_t key_sendPending(void);
+
 /********************************************************************************
  * Function Name: void key_pinReport(uint8_t code)
  ********************************************************************************
@@ -327,21 +375,172 @@ void key_sendRollover();
  *  payloadSize -- data length
  *
  * Return:
- *  TRUE -- if handled
+ *  none
  *
  *******************************************************************************/
-wiced_bool_t key_setReport(wiced_hidd_report_type_t reportType,
+void key_setReport(wiced_hidd_report_type_t reportType,
                      uint8_t reportId,
                      void *payload,
                      uint16_t payloadSize);
 
+/********************************************************************************
+ * Function Name: void key_play(uint8_t type, uint8_t value, uint8_t keyDown)
+ ********************************************************************************
+ * Summary: Process a key event that does not come from the key matrix and send
+ *          the reports it changed
+ *
+ * Parameters:
+ *  type -- key type
+ *  value -- translation value
+ *  keyDown -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_play(uint8_t type, uint8_t value, uint8_t keyDown);
+
+/********************************************************************************
+ * Function Name: void key_tapHoldPoll(void)
+ ********************************************************************************
+ * Summary: Resolve a pending dual role key once its tapping term has passed.
+ *          Called from the poll loop.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_tapHoldPoll(void);
+
+/********************************************************************************
+ * Function Name: void key_comboPoll(void)
+ ********************************************************************************
+ * Summary: Let go of keys held back for a combo once the combo window has passed.
+ *          Called from the poll loop.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_comboPoll(void);
+
+/********************************************************************************
+ * Function Name: void key_configInit(void)
+ ********************************************************************************
+ * Summary: Load the built-in keymap and build the per key combo membership masks.
+ *          Called before key events are processed.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_configInit(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t key_keymapValid(const KbKeyConfig *map, uint16_t count)
+ ********************************************************************************
+ * Summary: Check a keymap before it replaces the key table
+ *
+ * Parameters:
+ *  map -- keymap, one entry per key index
+ *  count -- number of entries in map
+ *
+ * Return:
+ *  TRUE if every entry can be processed by this firmware
+ *
+ *******************************************************************************/
+wiced_bool_t key_keymapValid(const KbKeyConfig *map, uint16_t count);
+
+/********************************************************************************
+ * Function Name: void key_setKeymap(const KbKeyConfig *map, wiced_bool_t sendRpt)
+ ********************************************************************************
+ * Summary: Replace the key table. Keys down are released first.
+ *
+ * Parameters:
+ *  map -- keymap checked with key_keymapValid, NULL for the built-in keymap
+ *  sendRpt -- TRUE to send the released reports
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_setKeymap(const KbKeyConfig *map, wiced_bool_t sendRpt);
+
+#ifdef SUPPORT_SCROLL
+/********************************************************************************
+ * Function Name: void key_scrollMotion(int16_t delta)
+ ********************************************************************************
+ * Summary: Add scroll motion to be sent. Motion is accumulated until the next
+ *          scroll report and saturates at the int16 range.
+ *
+ * Parameters:
+ *  delta -- scroll motion since the last call
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_scrollMotion(int16_t delta);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t key_scrollPending(void)
+ ********************************************************************************
+ * Summary: Check if there is scroll motion not sent yet
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if scroll motion is pending
+ *
+ *******************************************************************************/
+wiced_bool_t key_scrollPending(void);
+
+/********************************************************************************
+ * Function Name: void key_scrollSend(void)
+ ********************************************************************************
+ * Summary: Send the accumulated scroll motion, at most one report per call
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_scrollSend(void);
+#else
+ #define key_scrollMotion(d)
+ #define key_scrollPending() FALSE
+ #define key_scrollSend()
+#endif
+
 #else
  #define key_procEvtKey(c,d) TRUE
+ #define key_play(t,v,d)
+ #define key_tapHoldPoll()
+ #define key_comboPoll()
+ #define key_configInit()
+ #define key_keymapValid(m,c) FALSE
+ #define key_setKeymap(m,s)
+ #define key_scrollMotion(d)
+ #define key_scrollPending() FALSE
+ #define key_scrollSend()
  #define key_init()
  #define key_send()
+ #define key_sendPending() FALSE
  #define key_clear(s)
  #define key_sendRollover();
- #define key_setReport(t,r,p,s) FALSE
+ #define key_setReport NULL
 
 #endif // SUPPORT_KEY_REPORT
 #endif // __KEY_H__
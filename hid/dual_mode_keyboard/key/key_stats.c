@@ -0,0 +1,448 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Per key press and chatter counters
+ *
+ * Key events are counted in 16-bit RAM counters, one increment per event. A
+ * press counter that wraps spills into a per key 8-bit count. The RAM counters
+ * are added to the 32-bit press totals and 16-bit chatter totals kept in the
+ * journal in one batch, at disconnect, at shutdown and before deep sleep.
+ * Nothing is written per keystroke. The totals are split in records of a third
+ * of a journal page, so a page switch carries a few small records instead of
+ * rewriting a full page for each one.
+ *
+ * A press of the key released last, within KEY_STATS_CHATTER_MS of its
+ * release, is counted as chatter instead of as a press.
+ *
+ */
+
+#ifdef SUPPORT_KEY_STATS
+
+#include "app.h"
+#include "wiced_rtos.h"
+
+#define KEY_STATS_CHATTER_MS        30      // a press this soon after the release is chatter
+#define KEY_STATS_PRESS_PER_REC     16      // 32-bit press totals in one journal record
+#define KEY_STATS_CHATTER_PER_REC   32      // 16-bit chatter totals in one journal record
+#define KEY_STATS_PRESS_RECS        ((KEY_STATS_KEYS + KEY_STATS_PRESS_PER_REC - 1) / KEY_STATS_PRESS_PER_REC)
+#define KEY_STATS_CHATTER_RECS      ((KEY_STATS_KEYS + KEY_STATS_CHATTER_PER_REC - 1) / KEY_STATS_CHATTER_PER_REC)
+// keys in a record, the last record holds the remaining keys only
+#define KEY_STATS_PRESS_COUNT(rec)  ((KEY_STATS_KEYS - (rec) * KEY_STATS_PRESS_PER_REC < KEY_STATS_PRESS_PER_REC) ? \
+                                     KEY_STATS_KEYS - (rec) * KEY_STATS_PRESS_PER_REC : KEY_STATS_PRESS_PER_REC)
+#define KEY_STATS_CHATTER_COUNT(rec) ((KEY_STATS_KEYS - (rec) * KEY_STATS_CHATTER_PER_REC < KEY_STATS_CHATTER_PER_REC) ? \
+                                     KEY_STATS_KEYS - (rec) * KEY_STATS_CHATTER_PER_REC : KEY_STATS_CHATTER_PER_REC)
+
+#if (KEY_STATS_PRESS_RECS > 9) || (KEY_STATS_CHATTER_RECS > 5)
+# error "key statistics do not fit the journal records reserved for them"
+#endif
+
+KeyStatsReport keyStatsRpt;
+
+static struct {
+    uint16_t press[KEY_STATS_KEYS];         // presses since the last save
+    uint16_t chatter[KEY_STATS_KEYS];       // chatter since the last save
+    uint8_t  spill[KEY_STATS_KEYS];         // press counter wraps since the last save
+    uint16_t pending;                       // events since the last save, saturated
+    uint8_t  lastUpKey;
+    uint8_t  saveScheduled;                 // save queued to the application thread
+    uint32_t lastUpBtClk;
+} keyStats;
+
+/// journal record image
+static union {
+    uint32_t press[KEY_STATS_PRESS_PER_REC];
+    uint16_t chatter[KEY_STATS_CHATTER_PER_REC];
+} keyStatsNv;
+
+/********************************************************************************
+ * Function Name: KEY_STATS_savePress
+ ********************************************************************************
+ * Summary: add the press counters of one record to the totals in the journal
+ *
+ * Parameters:
+ *  rec -- record index
+ *
+ * Return:
+ *  FALSE if the record could not be written
+ *
+ *******************************************************************************/
+STATIC wiced_bool_t KEY_STATS_savePress(uint8_t rec)
+{
+    uint8_t first = rec * KEY_STATS_PRESS_PER_REC;
+    uint8_t count = KEY_STATS_PRESS_COUNT(rec);
+    uint8_t i, dirty = FALSE;
+
+    for (i = 0; i < count; i++)
+    {
+        dirty |= keyStats.press[first + i] || keyStats.spill[first + i];
+    }
+    if (!dirty)
+    {
+        return TRUE;
+    }
+
+    memset(keyStatsNv.press, 0, sizeof(keyStatsNv.press));
+    journal_read(JOURNAL_REC_KEY_PRESS + rec, keyStatsNv.press, count * sizeof(uint32_t));
+    for (i = 0; i < count; i++)
+    {
+        keyStatsNv.press[i] += keyStats.press[first + i] + ((uint32_t) keyStats.spill[first + i] << 16);
+    }
+
+    return journal_write(JOURNAL_REC_KEY_PRESS + rec, keyStatsNv.press, count * sizeof(uint32_t));
+}
+
+/********************************************************************************
+ * Function Name: KEY_STATS_saveChatter
+ ********************************************************************************
+ * Summary: add the chatter counters of one record to the totals in the journal
+ *
+ * Parameters:
+ *  rec -- record index
+ *
+ * Return:
+ *  FALSE if the record could not be written
+ *
+ *******************************************************************************/
+STATIC wiced_bool_t KEY_STATS_saveChatter(uint8_t rec)
+{
+    uint8_t first = rec * KEY_STATS_CHATTER_PER_REC;
+    uint8_t count = KEY_STATS_CHATTER_COUNT(rec);
+    uint8_t i, dirty = FALSE;
+    uint32_t total;
+
+    for (i = 0; i < count; i++)
+    {
+        dirty |= keyStats.chatter[first + i] != 0;
+    }
+    if (!dirty)
+    {
+        return TRUE;
+    }
+
+    memset(keyStatsNv.chatter, 0, sizeof(keyStatsNv.chatter));
+    journal_read(JOURNAL_REC_KEY_CHATTER + rec, keyStatsNv.chatter, count * sizeof(uint16_t));
+    for (i = 0; i < count; i++)
+    {
+        total = keyStatsNv.chatter[i] + keyStats.chatter[first + i];
+        keyStatsNv.chatter[i] = total > 0xffff ? 0xffff : total;
+    }
+
+    return journal_write(JOURNAL_REC_KEY_CHATTER + rec, keyStatsNv.chatter, count * sizeof(uint16_t));
+}
+
+/********************************************************************************
+ * Function Name: KEY_STATS_fillReport
+ ********************************************************************************
+ * Summary: fill the report with the totals of a page, unsaved counters included
+ *
+ * Parameters:
+ *  page -- report page
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void KEY_STATS_fillReport(uint8_t page)
+{
+    uint8_t first = page * KEY_STATS_RPT_KEYS;
+    uint8_t rec, key, i;
+    uint32_t total;
+
+    memset(&keyStatsRpt.press, 0, sizeof(keyStatsRpt) - 2);
+    keyStatsRpt.page = page;
+    if (page == KEY_STATS_RPT_LINK)
+    {
+        for (i = 0; i < BREDR_PM_STATE_MAX; i++)
+        {
+            keyStatsRpt.press[i] = bredr_pmTimeInState(i);
+        }
+        keyStatsRpt.press[BREDR_PM_STATE_MAX] = bredr_pmTransitions();
+        return;
+    }
+    if (page >= KEY_STATS_RPT_PAGES)
+    {
+        return;
+    }
+
+    // a page never spans two journal records, each is read with the length it is saved with
+    rec = first / KEY_STATS_PRESS_PER_REC;
+    memset(keyStatsNv.press, 0, sizeof(keyStatsNv.press));
+    journal_read(JOURNAL_REC_KEY_PRESS + rec, keyStatsNv.press, KEY_STATS_PRESS_COUNT(rec) * sizeof(uint32_t));
+    for (i = 0; i < KEY_STATS_RPT_KEYS && (key = first + i) < KEY_STATS_KEYS; i++)
+    {
+        keyStatsRpt.press[i] = keyStatsNv.press[key % KEY_STATS_PRESS_PER_REC] + keyStats.press[key] + ((uint32_t) keyStats.spill[key] << 16);
+    }
+
+    rec = first / KEY_STATS_CHATTER_PER_REC;
+    memset(keyStatsNv.chatter, 0, sizeof(keyStatsNv.chatter));
+    journal_read(JOURNAL_REC_KEY_CHATTER + rec, keyStatsNv.chatter, KEY_STATS_CHATTER_COUNT(rec) * sizeof(uint16_t));
+    for (i = 0; i < KEY_STATS_RPT_KEYS && (key = first + i) < KEY_STATS_KEYS; i++)
+    {
+        total = keyStatsNv.chatter[key % KEY_STATS_CHATTER_PER_REC] + keyStats.chatter[key];
+        keyStatsRpt.chatter[i] = total > 0xffff ? 0xffff : total;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void key_statsInit(void)
+ ********************************************************************************
+ * Summary: Initialize the key statistics report
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsInit(void)
+{
+    keyStats.lastUpKey = 0xff;
+    keyStatsRpt.reportID = RPT_ID_FEATURE_KEY_STATS;
+    KEY_STATS_fillReport(0);
+}
+
+/********************************************************************************
+ * Function Name: void key_statsCount(uint8_t keyCode, uint8_t keyDown)
+ ********************************************************************************
+ * Summary: Count a key event
+ *
+ * Parameters:
+ *  keyCode -- key index
+ *  keyDown -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsCount(uint8_t keyCode, uint8_t keyDown)
+{
+    if (keyCode >= KEY_STATS_KEYS)
+    {
+        return;
+    }
+
+    if (keyStats.pending != 0xffff)
+    {
+        keyStats.pending++;
+    }
+
+    if (!keyDown)
+    {
+        keyStats.lastUpKey = keyCode;
+        keyStats.lastUpBtClk = wiced_hidd_get_current_native_bt_clocks();
+    }
+    else if ((keyCode == keyStats.lastUpKey) &&
+             (wiced_hidd_get_bt_clocks_since(keyStats.lastUpBtClk) < MS_TO_BT_CLOCKS(KEY_STATS_CHATTER_MS)))
+    {
+        if (keyStats.chatter[keyCode] != 0xffff)
+        {
+            keyStats.chatter[keyCode]++;
+        }
+    }
+    else if (!++keyStats.press[keyCode])
+    {
+        keyStats.spill[keyCode]++;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void key_statsSave(void)
+ ********************************************************************************
+ * Summary: Add the RAM counters to the totals in the journal. The records go
+ *          out in one journal batch.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsSave(void)
+{
+    uint16_t pressSaved = 0, chatterSaved = 0;
+    uint8_t rec, first, count;
+
+    if (!keyStats.pending)
+    {
+        return;
+    }
+
+    journal_batchBegin();
+    for (rec = 0; rec < KEY_STATS_PRESS_RECS; rec++)
+    {
+        pressSaved |= KEY_STATS_savePress(rec) << rec;
+    }
+    for (rec = 0; rec < KEY_STATS_CHATTER_RECS; rec++)
+    {
+        chatterSaved |= KEY_STATS_saveChatter(rec) << rec;
+    }
+
+    // the counters are kept for the next save if the write fails
+    if (!journal_batchEnd())
+    {
+        return;
+    }
+
+    for (rec = 0; rec < KEY_STATS_PRESS_RECS; rec++)
+    {
+        first = rec * KEY_STATS_PRESS_PER_REC;
+        count = KEY_STATS_PRESS_COUNT(rec);
+        if (pressSaved & (1 << rec))
+        {
+            memset(&keyStats.press[first], 0, count * sizeof(uint16_t));
+            memset(&keyStats.spill[first], 0, count);
+        }
+    }
+    for (rec = 0; rec < KEY_STATS_CHATTER_RECS; rec++)
+    {
+        first = rec * KEY_STATS_CHATTER_PER_REC;
+        count = KEY_STATS_CHATTER_COUNT(rec);
+        if (chatterSaved & (1 << rec))
+        {
+            memset(&keyStats.chatter[first], 0, count * sizeof(uint16_t));
+        }
+    }
+    if ((pressSaved == (1 << KEY_STATS_PRESS_RECS) - 1) && (chatterSaved == (1 << KEY_STATS_CHATTER_RECS) - 1))
+    {
+        keyStats.pending = 0;
+    }
+}
+
+/********************************************************************************
+ * Function Name: KEY_STATS_saveEvt
+ ********************************************************************************
+ * Summary: save queued by key_statsReadyForSleep()
+ *
+ * Parameters:
+ *  data -- not used
+ *
+ * Return:
+ *  0
+ *
+ *******************************************************************************/
+STATIC int KEY_STATS_saveEvt(void * data)
+{
+    keyStats.saveScheduled = FALSE;
+    key_statsSave();
+
+    // a failed save does not hold deep sleep off, the counters go with the next save
+    keyStats.pending = 0;
+    return 0;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t key_statsReadyForSleep(void)
+ ********************************************************************************
+ * Summary: Check the counters before deep sleep. Pending counters are saved
+ *          from the application thread, not from the sleep callback.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if nothing is left to save
+ *
+ *******************************************************************************/
+wiced_bool_t key_statsReadyForSleep(void)
+{
+    if (!keyStats.pending)
+    {
+        return TRUE;
+    }
+
+    if (!keyStats.saveScheduled)
+    {
+        keyStats.saveScheduled = wiced_app_event_serialize(KEY_STATS_saveEvt, NULL);
+    }
+    return FALSE;
+}
+
+/********************************************************************************
+ * Function Name: void key_statsSetReport(...)
+ ********************************************************************************
+ * Summary: Key statistics feature report write, selects the page to read
+ *
+ * Parameters:
+ *  reportType -- WICED_HID_REPORT_TYPE_FEATURE
+ *  reportId -- RPT_ID_FEATURE_KEY_STATS
+ *  payload -- page number, KEY_STATS_RPT_LINK for the link counters,
+ *             KEY_STATS_RPT_RESET to clear the counters
+ *  payloadSize -- payload length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsSetReport(wiced_hidd_report_type_t reportType,
+                     uint8_t reportId,
+                     void *payload,
+                     uint16_t payloadSize)
+{
+    uint8_t page;
+    uint8_t rec;
+
+    if (!payloadSize)
+    {
+        return;
+    }
+    page = *((uint8_t*)payload);
+
+    if (page == KEY_STATS_RPT_RESET)
+    {
+        WICED_BT_TRACE("\nkey stats cleared");
+        memset(keyStats.press, 0, sizeof(keyStats.press));
+        memset(keyStats.chatter, 0, sizeof(keyStats.chatter));
+        memset(keyStats.spill, 0, sizeof(keyStats.spill));
+        keyStats.pending = 0;
+        keyStats.lastUpKey = 0xff;
+        journal_batchBegin();
+        for (rec = 0; rec < KEY_STATS_PRESS_RECS; rec++)
+        {
+            journal_write(JOURNAL_REC_KEY_PRESS + rec, NULL, 0);
+        }
+        for (rec = 0; rec < KEY_STATS_CHATTER_RECS; rec++)
+        {
+            journal_write(JOURNAL_REC_KEY_CHATTER + rec, NULL, 0);
+        }
+        journal_batchEnd();
+        page = 0;
+    }
+
+    KEY_STATS_fillReport(page);
+}
+
+#endif // SUPPORT_KEY_STATS
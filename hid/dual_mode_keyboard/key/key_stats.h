@@ -0,0 +1,160 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Per key press and chatter counters
+ *
+ */
+#ifndef __KEY_STATS_H__
+#define __KEY_STATS_H__
+
+#ifdef SUPPORT_KEY_STATS
+
+#include "wiced.h"
+
+#define KEY_STATS_KEYS              (NUM_KEYSCAN_ROWS * NUM_KEYSCAN_COLS)
+#define KEY_STATS_RPT_KEYS          8       // keys in one report page
+#define KEY_STATS_RPT_PAGES         ((KEY_STATS_KEYS + KEY_STATS_RPT_KEYS - 1) / KEY_STATS_RPT_KEYS)
+#define KEY_STATS_RPT_SIZE          (1 + KEY_STATS_RPT_KEYS * 6)    // report size, report ID excluded
+#define KEY_STATS_RPT_RESET         0xff    // page number written to clear all the counters
+#define KEY_STATS_RPT_LINK          0xfe    // page number of the BR/EDR link power state counters
+
+#pragma pack(1)
+/// Key statistics feature report. The host writes the page number, then reads the page.
+/// The KEY_STATS_RPT_LINK page carries the time in each bredr_pm_state_e in ms in press[],
+/// followed by the number of state changes.
+typedef PACKED struct
+{
+    /// Set to the value specified in the config record.
+    uint8_t    reportID;
+
+    /// Page number, the first key of the page is page * KEY_STATS_RPT_KEYS
+    uint8_t    page;
+
+    /// Presses of each key
+    uint32_t   press[KEY_STATS_RPT_KEYS];
+
+    /// Presses that came right after the release of the same key, counted apart
+    uint16_t   chatter[KEY_STATS_RPT_KEYS];
+}KeyStatsReport;
+#pragma pack()
+
+extern KeyStatsReport keyStatsRpt;
+
+/********************************************************************************
+ * Function Name: void key_statsInit(void)
+ ********************************************************************************
+ * Summary: Initialize the key statistics report. Called after journal_init().
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsInit(void);
+
+/********************************************************************************
+ * Function Name: void key_statsCount(uint8_t keyCode, uint8_t keyDown)
+ ********************************************************************************
+ * Summary: Count a key event. Only RAM counters are touched.
+ *
+ * Parameters:
+ *  keyCode -- key index
+ *  keyDown -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsCount(uint8_t keyCode, uint8_t keyDown);
+
+/********************************************************************************
+ * Function Name: void key_statsSave(void)
+ ********************************************************************************
+ * Summary: Add the RAM counters to the totals in the journal
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsSave(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t key_statsReadyForSleep(void)
+ ********************************************************************************
+ * Summary: Check the counters before deep sleep. Pending counters are queued
+ *          to be saved from the application thread.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if nothing is left to save
+ *
+ *******************************************************************************/
+wiced_bool_t key_statsReadyForSleep(void);
+
+/********************************************************************************
+ * Function Name: void key_statsSetReport(...)
+ ********************************************************************************
+ * Summary: Key statistics feature report write, selects the page to read
+ *
+ * Parameters:
+ *  reportType -- WICED_HID_REPORT_TYPE_FEATURE
+ *  reportId -- RPT_ID_FEATURE_KEY_STATS
+ *  payload -- page number, KEY_STATS_RPT_LINK for the link counters,
+ *             KEY_STATS_RPT_RESET to clear the counters
+ *  payloadSize -- payload length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void key_statsSetReport(wiced_hidd_report_type_t reportType,
+                     uint8_t reportId,
+                     void *payload,
+                     uint16_t payloadSize);
+
+#else
+# define key_statsInit()
+# define key_statsCount(k,d)
+# define key_statsSave()
+# define key_statsReadyForSleep() TRUE
+#endif // SUPPORT_KEY_STATS
+#endif // __KEY_STATS_H__
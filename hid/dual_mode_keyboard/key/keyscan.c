@@ -53,7 +53,7 @@ static kscan_data_t ks = {};
 /// FW event queue. Events from the keyscan driver are processed until the driver
 /// runs out of events.
 /////////////////////////////////////////////////////////////////////////////////
-STATIC void KSCAN_pollEvent(void * userData)
+APP_HOT STATIC void KSCAN_pollEvent(void * userData)
 {
     HidEventKey event = {{HID_EVENT_KEY_STATE_CHANGE}};
 
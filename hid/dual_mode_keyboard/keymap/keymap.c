@@ -0,0 +1,411 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Keymap upload service
+ *
+ * The blob is collected in a RAM staging buffer. COMMIT checks the length and
+ * the CRC32, checks the content, saves it to NVRAM and only then applies it,
+ * so the key table is either fully replaced or left untouched. The key table
+ * is replaced between two key events, the GATT callbacks run in the same
+ * thread as the key processing.
+ *
+ * The keymap is larger than one NVRAM record, it is saved in two records. The
+ * first one starts with the length and CRC32 of the whole keymap so a keymap
+ * half written when power is lost is not applied at the next boot.
+ *
+ */
+
+#ifdef SUPPORT_KEYMAP
+#include "app.h"
+#include "wiced_hal_nvram.h"
+
+#define KEYMAP_MAX_LEN              320     // staging buffer, largest blob
+#define KEYMAP_NV_PART_LEN          232     // keymap bytes in the first NVRAM record
+#define KEYMAP_crc32(buf, len)      (app_crc32Update(0xffffffff, buf, len) ^ 0xffffffff)
+
+#pragma pack(1)
+/// START command parameters
+typedef PACKED struct {
+    uint8_t  cmd;
+    uint8_t  type;                          // KEYMAP_BLOB_xxx
+    uint8_t  slot;                          // macro slot, unused for the keymap
+    uint16_t len;                           // blob length
+    uint32_t crc32;                         // blob CRC32
+} keymap_start_t;
+
+/// Header of the first keymap NVRAM record
+typedef PACKED struct {
+    uint16_t len;
+    uint32_t crc32;
+} keymap_nv_hdr_t;
+#pragma pack()
+
+static struct {
+    uint8_t  active;                        // START received, waiting for COMMIT
+    uint8_t  overflow;                      // data written past the announced length
+    uint8_t  type;
+    uint8_t  slot;
+    uint16_t cccd;
+    uint16_t len;                           // announced blob length
+    uint16_t rxLen;                         // blob bytes received
+    uint32_t crc32;                         // announced blob CRC32
+    uint8_t  buf[KEYMAP_MAX_LEN];
+} keymap;
+
+/********************************************************************************
+ * Function Name: KEYMAP_sendStatus
+ ********************************************************************************
+ * Summary: notify the command status through the control point
+ *
+ * Parameters:
+ *  cmd -- command
+ *  status -- KEYMAP_STATUS_xxx
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void KEYMAP_sendStatus(uint8_t cmd, uint8_t status)
+{
+    uint8_t rsp[2] = {cmd, status};
+
+    if (keymap.cccd & GATT_CLIENT_CONFIG_NOTIFICATION)
+    {
+        wiced_bt_gatt_send_notification(hidd_blelink.gatts_conn_id, HANDLE_KEYMAP_CONTROL_POINT, sizeof(rsp), rsp);
+    }
+}
+
+/********************************************************************************
+ * Function Name: KEYMAP_end
+ ********************************************************************************
+ * Summary: end the upload and release its request for the OTA link profile
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void KEYMAP_end(void)
+{
+    if (keymap.active)
+    {
+        keymap.active = FALSE;
+        ble_set_link_profile(BLE_LINK_PROFILE_TYPING);
+    }
+}
+
+/********************************************************************************
+ * Function Name: KEYMAP_save
+ ********************************************************************************
+ * Summary: save the keymap in the staging buffer to NVRAM
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if both records are written
+ *
+ *******************************************************************************/
+STATIC wiced_bool_t KEYMAP_save(void)
+{
+    uint8_t rec[sizeof(keymap_nv_hdr_t) + KEYMAP_NV_PART_LEN];
+    keymap_nv_hdr_t * hdr = (keymap_nv_hdr_t *) rec;
+    uint16_t partLen = keymap.len < KEYMAP_NV_PART_LEN ? keymap.len : KEYMAP_NV_PART_LEN;
+    wiced_result_t result;
+
+    hdr->len = keymap.len;
+    hdr->crc32 = keymap.crc32;
+    memcpy(&rec[sizeof(keymap_nv_hdr_t)], keymap.buf, partLen);
+
+    // the second record first, the header only validates the pair once it is written
+    if (keymap.len > partLen)
+    {
+        wiced_hal_write_nvram(VS_ID_KEYMAP + 1, keymap.len - partLen, &keymap.buf[partLen], &result);
+        if (result != WICED_SUCCESS)
+        {
+            return FALSE;
+        }
+    }
+    wiced_hal_write_nvram(VS_ID_KEYMAP, sizeof(keymap_nv_hdr_t) + partLen, rec, &result);
+    return result == WICED_SUCCESS;
+}
+
+/********************************************************************************
+ * Function Name: KEYMAP_commit
+ ********************************************************************************
+ * Summary: check the received blob and apply it
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  KEYMAP_STATUS_xxx
+ *
+ *******************************************************************************/
+STATIC uint8_t KEYMAP_commit(void)
+{
+    if (keymap.overflow || (keymap.rxLen != keymap.len))
+    {
+        return KEYMAP_STATUS_LENGTH_MISMATCH;
+    }
+    if (KEYMAP_crc32(keymap.buf, keymap.len) != keymap.crc32)
+    {
+        return KEYMAP_STATUS_CRC_MISMATCH;
+    }
+
+    switch (keymap.type)
+    {
+        case KEYMAP_BLOB_KEYMAP:
+            if ((keymap.len % sizeof(KbKeyConfig)) ||
+                !key_keymapValid((KbKeyConfig *) keymap.buf, keymap.len / sizeof(KbKeyConfig)))
+            {
+                return KEYMAP_STATUS_INVALID_CONTENT;
+            }
+            if (!KEYMAP_save())
+            {
+                return KEYMAP_STATUS_NVRAM_ERROR;
+            }
+            key_setKeymap((KbKeyConfig *) keymap.buf, TRUE);
+            break;
+
+        case KEYMAP_BLOB_MACRO:
+            if (!macro_store(keymap.slot, keymap.buf, keymap.len))
+            {
+                return KEYMAP_STATUS_NVRAM_ERROR;
+            }
+            break;
+
+        default:
+            return KEYMAP_STATUS_UNSUPPORTED;
+    }
+    return KEYMAP_STATUS_OK;
+}
+
+/********************************************************************************
+ * Function Name: void keymap_init(void)
+ ********************************************************************************
+ * Summary: Apply the keymap saved in NVRAM, if any
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_init(void)
+{
+    uint8_t rec[sizeof(keymap_nv_hdr_t) + KEYMAP_NV_PART_LEN];
+    keymap_nv_hdr_t * hdr = (keymap_nv_hdr_t *) rec;
+    uint16_t len, partLen;
+    wiced_result_t result;
+
+    len = wiced_hal_read_nvram(VS_ID_KEYMAP, sizeof(rec), rec, &result);
+    if ((result != WICED_SUCCESS) || (len < sizeof(keymap_nv_hdr_t)) || (hdr->len > KEYMAP_MAX_LEN))
+    {
+        return;
+    }
+
+    partLen = len - sizeof(keymap_nv_hdr_t);
+    memcpy(keymap.buf, &rec[sizeof(keymap_nv_hdr_t)], partLen);
+    if (hdr->len > partLen)
+    {
+        len = wiced_hal_read_nvram(VS_ID_KEYMAP + 1, hdr->len - partLen, &keymap.buf[partLen], &result);
+        if ((result != WICED_SUCCESS) || (partLen + len != hdr->len))
+        {
+            return;
+        }
+    }
+
+    if ((KEYMAP_crc32(keymap.buf, hdr->len) == hdr->crc32) &&
+        key_keymapValid((KbKeyConfig *) keymap.buf, hdr->len / sizeof(KbKeyConfig)))
+    {
+        WICED_BT_TRACE("\nkeymap loaded, %d bytes", hdr->len);
+        key_setKeymap((KbKeyConfig *) keymap.buf, FALSE);
+    }
+}
+
+/********************************************************************************
+ * Function Name: void keymap_controlPointWrite()
+ ********************************************************************************
+ * Summary: Keymap control point write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- command followed by its parameters
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_controlPointWrite(wiced_hidd_report_type_t reportType,
+                              uint8_t reportId,
+                              void *payload,
+                              uint16_t payloadSize)
+{
+    keymap_start_t * start = (keymap_start_t *) payload;
+    uint8_t cmd = payloadSize ? *(uint8_t *) payload : 0;
+    uint8_t status = KEYMAP_STATUS_OK;
+    wiced_result_t result;
+
+    switch (cmd)
+    {
+        case KEYMAP_CMD_START:
+            if (payloadSize != sizeof(keymap_start_t) || (start->len > KEYMAP_MAX_LEN))
+            {
+                status = KEYMAP_STATUS_BAD_PARAM;
+                break;
+            }
+            keymap.type = start->type;
+            keymap.slot = start->slot;
+            keymap.len = start->len;
+            keymap.crc32 = start->crc32;
+            keymap.rxLen = 0;
+            keymap.overflow = FALSE;
+            if (!keymap.active)
+            {
+                // a full keymap then fits in a couple of connection events
+                keymap.active = TRUE;
+                ble_set_link_profile(BLE_LINK_PROFILE_OTA);
+            }
+            break;
+
+        case KEYMAP_CMD_COMMIT:
+            status = keymap.active ? KEYMAP_commit() : KEYMAP_STATUS_ILLEGAL_STATE;
+            KEYMAP_end();
+            break;
+
+        case KEYMAP_CMD_ABORT:
+            KEYMAP_end();
+            break;
+
+        case KEYMAP_CMD_RESET:
+            wiced_hal_delete_nvram(VS_ID_KEYMAP, &result);
+            wiced_hal_delete_nvram(VS_ID_KEYMAP + 1, &result);
+            key_setKeymap(NULL, TRUE);
+            break;
+
+        default:
+            status = KEYMAP_STATUS_UNSUPPORTED;
+            break;
+    }
+
+    WICED_BT_TRACE("\nkeymap cmd:%d status:%d", cmd, status);
+    KEYMAP_sendStatus(cmd, status);
+}
+
+/********************************************************************************
+ * Function Name: void keymap_clientConfWrite()
+ ********************************************************************************
+ * Summary: Keymap control point client configuration write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- client configuration value
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_clientConfWrite(wiced_hidd_report_type_t reportType,
+                            uint8_t reportId,
+                            void *payload,
+                            uint16_t payloadSize)
+{
+    if (payloadSize >= sizeof(uint16_t))
+    {
+        keymap.cccd = *(uint16_t *)payload;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void keymap_dataWrite()
+ ********************************************************************************
+ * Summary: Keymap data write handler. Data is appended to the blob being uploaded.
+ *          Errors are reported at COMMIT, the write has no response.
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- blob data
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_dataWrite(wiced_hidd_report_type_t reportType,
+                      uint8_t reportId,
+                      void *payload,
+                      uint16_t payloadSize)
+{
+    if (!keymap.active)
+    {
+        return;
+    }
+
+    if (keymap.rxLen + payloadSize > keymap.len)
+    {
+        keymap.overflow = TRUE;
+        return;
+    }
+    memcpy(&keymap.buf[keymap.rxLen], payload, payloadSize);
+    keymap.rxLen += payloadSize;
+}
+
+/********************************************************************************
+ * Function Name: void keymap_disconnected(void)
+ ********************************************************************************
+ * Summary: LE link is down, drop the upload in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_disconnected(void)
+{
+    keymap.active = FALSE;
+}
+
+#endif // SUPPORT_KEYMAP
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Keymap upload service
+ *
+ * Vendor specific GATT service next to the OTA service. The host uploads a
+ * blob (the keymap or a macro) and the device applies it only after the whole
+ * blob is received and its CRC32 matches.
+ *
+ * Control point, write with response, results are notified:
+ *   START   0x01, type, slot, uint16 length, uint32 CRC32 (IEEE 802.3)
+ *   COMMIT  0x02
+ *   ABORT   0x03
+ *   RESET   0x04, restore the built-in keymap
+ * Notification: command, status
+ *
+ * Data, write without response: blob bytes in order, up to the ATT MTU each.
+ *
+ */
+
+#ifndef __APP_KEYMAP_H__
+#define __APP_KEYMAP_H__
+
+#ifdef SUPPORT_KEYMAP
+#include "wiced.h"
+
+/// Keymap service, UUID: 8e5a0b20-6c31-4f2b-9d6e-2f1c3a7b4d01
+#define UUID_KEYMAP_SERVICE                 0x01, 0x4d, 0x7b, 0x3a, 0x1c, 0x2f, 0x6e, 0x9d, 0x2b, 0x4f, 0x31, 0x6c, 0x20, 0x0b, 0x5a, 0x8e
+/// Control point, UUID: 8e5a0b21-6c31-4f2b-9d6e-2f1c3a7b4d01
+#define UUID_KEYMAP_CHARACTERISTIC_CONTROL_POINT 0x01, 0x4d, 0x7b, 0x3a, 0x1c, 0x2f, 0x6e, 0x9d, 0x2b, 0x4f, 0x31, 0x6c, 0x21, 0x0b, 0x5a, 0x8e
+/// Data, UUID: 8e5a0b22-6c31-4f2b-9d6e-2f1c3a7b4d01
+#define UUID_KEYMAP_CHARACTERISTIC_DATA     0x01, 0x4d, 0x7b, 0x3a, 0x1c, 0x2f, 0x6e, 0x9d, 0x2b, 0x4f, 0x31, 0x6c, 0x22, 0x0b, 0x5a, 0x8e
+
+/// Keymap service handles, after the OTA service
+typedef enum {
+    HANDLE_KEYMAP_SERVICE = 0xff20,
+        HANDLE_KEYMAP_CHARACTERISTIC_CONTROL_POINT,
+        HANDLE_KEYMAP_CONTROL_POINT,
+        HANDLE_KEYMAP_CLIENT_CONFIGURATION_DESCRIPTOR,
+        HANDLE_KEYMAP_CHARACTERISTIC_DATA,
+        HANDLE_KEYMAP_DATA,
+} keymap_handle_e;
+
+/// Control point commands
+enum {
+    KEYMAP_CMD_START = 1,
+    KEYMAP_CMD_COMMIT,
+    KEYMAP_CMD_ABORT,
+    KEYMAP_CMD_RESET,
+};
+
+/// Blob types given in START
+enum {
+    KEYMAP_BLOB_KEYMAP,             // KbKeyConfig for every key index
+    KEYMAP_BLOB_LAYER,              // reserved, the firmware has no layers
+    KEYMAP_BLOB_MACRO,              // encoded macro for the slot
+};
+
+/// Command status
+enum {
+    KEYMAP_STATUS_OK,
+    KEYMAP_STATUS_ILLEGAL_STATE,
+    KEYMAP_STATUS_BAD_PARAM,
+    KEYMAP_STATUS_LENGTH_MISMATCH,
+    KEYMAP_STATUS_CRC_MISMATCH,
+    KEYMAP_STATUS_INVALID_CONTENT,
+    KEYMAP_STATUS_NVRAM_ERROR,
+    KEYMAP_STATUS_UNSUPPORTED,
+};
+
+/********************************************************************************
+ * Function Name: void keymap_init(void)
+ ********************************************************************************
+ * Summary: Apply the keymap saved in NVRAM, if any
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_init(void);
+
+/********************************************************************************
+ * Function Name: void keymap_controlPointWrite()
+ ********************************************************************************
+ * Summary: Keymap control point write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- command followed by its parameters
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_controlPointWrite(wiced_hidd_report_type_t reportType,
+                              uint8_t reportId,
+                              void *payload,
+                              uint16_t payloadSize);
+
+/********************************************************************************
+ * Function Name: void keymap_clientConfWrite()
+ ********************************************************************************
+ * Summary: Keymap control point client configuration write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- client configuration value
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_clientConfWrite(wiced_hidd_report_type_t reportType,
+                            uint8_t reportId,
+                            void *payload,
+                            uint16_t payloadSize);
+
+/********************************************************************************
+ * Function Name: void keymap_dataWrite()
+ ********************************************************************************
+ * Summary: Keymap data write handler. Data is appended to the blob being uploaded.
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- blob data
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_dataWrite(wiced_hidd_report_type_t reportType,
+                      uint8_t reportId,
+                      void *payload,
+                      uint16_t payloadSize);
+
+/********************************************************************************
+ * Function Name: void keymap_disconnected(void)
+ ********************************************************************************
+ * Summary: LE link is down, drop the upload in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void keymap_disconnected(void);
+
+#else
+# define keymap_init()
+# define keymap_disconnected()
+#endif
+#endif // __APP_KEYMAP_H__
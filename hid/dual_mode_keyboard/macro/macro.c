@@ -0,0 +1,445 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Macro recorder and paced playback
+ *
+ * Recorded events are encoded compactly, one header byte per event:
+ *   bit 7     key down
+ *   bit 6     the value is a modifier mask, otherwise a standard key usage
+ *   bit 5     same value as the previous event, no value byte follows
+ *   bit 4-0   delay since the previous event in 10 ms ticks. 31 means an extra
+ *             byte follows, the delay is 31 plus that byte
+ * followed by the value byte, stored as the difference to the previous value.
+ * A key tap usually takes 3 bytes: down with its value, up with the repeat flag.
+ *
+ * Playback does not go through the event queue. macro_poll is called once per
+ * connection event and sends at most one event, only when the event delay has
+ * passed and the ACL pool has room, so a long macro cannot overrun the queue
+ * or the transport.
+ *
+ */
+
+#ifdef SUPPORT_MACRO
+#include "wiced_hal_nvram.h"
+#include "wiced_memory.h"
+#include "gki_target.h"
+#include "app.h"
+
+#define MACRO_MAX_LEN               240     // encoded bytes in one macro, fits one NVRAM record
+#define MACRO_TICK_MS               10      // delay resolution
+#define MACRO_EVT_DOWN              0x80
+#define MACRO_EVT_MOD               0x40
+#define MACRO_EVT_REPEAT            0x20
+#define MACRO_EVT_DELAY_MASK        0x1f
+#define MACRO_DELAY_EXT             MACRO_EVT_DELAY_MASK        // an extra delay byte follows
+#define MACRO_DELAY_MAX             (MACRO_DELAY_EXT + 0xff)    // longer pauses are shortened to this
+
+typedef enum {
+    MACRO_IDLE,
+    MACRO_ARMED,            // record key pressed, waiting for the macro key
+    MACRO_RECORDING,
+    MACRO_PLAYING,
+} macro_state_e;
+
+static struct {
+    uint8_t     state;
+    uint8_t     slot;                   // slot being recorded
+    uint8_t     len;                    // encoded bytes in buf
+    uint8_t     pos;                    // playback position in buf
+    uint8_t     balancedLen;            // recording length when no recorded key was down
+    uint8_t     keysDown;               // recorded keys still down
+    uint8_t     prevValue;              // values are stored as difference to this one
+    uint32_t    lastBtClk;              // time of the previous event
+    uint8_t     buf[MACRO_MAX_LEN];     // macro being recorded or played
+} macro;
+
+/********************************************************************************
+ * Function Name: MACRO_save
+ ********************************************************************************
+ * Summary: Save the recorded macro to the NVRAM record of its slot. The macro is
+ *          cut at the last point where no recorded key was down, so playback
+ *          never leaves a key pressed. An empty macro deletes the slot.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void MACRO_save(void)
+{
+    wiced_result_t result;
+
+    if (macro.balancedLen)
+    {
+        wiced_hal_write_nvram(VS_ID_MACRO + macro.slot, macro.balancedLen, macro.buf, &result);
+    }
+    else
+    {
+        wiced_hal_delete_nvram(VS_ID_MACRO + macro.slot, &result);
+    }
+    WICED_BT_TRACE("\nmacro %d saved, %d bytes, result:%d", macro.slot, macro.balancedLen, result);
+    macro.state = MACRO_IDLE;
+}
+
+/********************************************************************************
+ * Function Name: MACRO_play
+ ********************************************************************************
+ * Summary: Load the macro of the slot from NVRAM and start playing it
+ *
+ * Parameters:
+ *  slot -- macro slot
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void MACRO_play(uint8_t slot)
+{
+    wiced_result_t result;
+
+    macro.len = wiced_hal_read_nvram(VS_ID_MACRO + slot, MACRO_MAX_LEN, macro.buf, &result);
+    if ((result != WICED_SUCCESS) || !macro.len)
+    {
+        WICED_BT_TRACE("\nmacro %d empty", slot);
+        return;
+    }
+
+    macro.pos = 0;
+    macro.prevValue = 0;
+    macro.lastBtClk = wiced_hidd_get_current_native_bt_clocks();
+    macro.state = MACRO_PLAYING;
+}
+
+/********************************************************************************
+ * Function Name: void macro_recordKey(uint8_t down)
+ ********************************************************************************
+ * Summary: Record key event. Arms the recorder, or saves the macro being recorded.
+ *
+ * Parameters:
+ *  down -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_recordKey(uint8_t down)
+{
+    if (!down)
+    {
+        return;
+    }
+
+    switch (macro.state)
+    {
+        case MACRO_IDLE:
+            WICED_BT_TRACE("\nmacro armed");
+            macro.state = MACRO_ARMED;
+            break;
+        case MACRO_ARMED:
+            WICED_BT_TRACE("\nmacro canceled");
+            macro.state = MACRO_IDLE;
+            break;
+        case MACRO_RECORDING:
+            MACRO_save();
+            break;
+        default:
+            // let the playback finish first
+            break;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void macro_key(uint8_t slot, uint8_t down)
+ ********************************************************************************
+ * Summary: Macro key event. Selects the slot to record when the recorder is armed,
+ *          otherwise starts the playback of the slot.
+ *
+ * Parameters:
+ *  slot -- macro slot, less than MACRO_SLOTS
+ *  down -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_key(uint8_t slot, uint8_t down)
+{
+    if (!down || (slot >= MACRO_SLOTS))
+    {
+        return;
+    }
+
+    switch (macro.state)
+    {
+        case MACRO_ARMED:
+            WICED_BT_TRACE("\nmacro %d recording", slot);
+            macro.slot = slot;
+            macro.len = macro.balancedLen = macro.keysDown = macro.prevValue = 0;
+            macro.state = MACRO_RECORDING;
+            break;
+        case MACRO_IDLE:
+            MACRO_play(slot);
+            break;
+        default:
+            break;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void macro_record(uint8_t down, uint8_t isMod, uint8_t value)
+ ********************************************************************************
+ * Summary: Add a key event to the macro being recorded. Ignored when not recording.
+ *          When the buffer is full the macro is saved and recording stops.
+ *
+ * Parameters:
+ *  down -- key up or down
+ *  isMod -- TRUE if value is a modifier mask, FALSE if it is a standard key usage
+ *  value -- usage or modifier mask
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_record(uint8_t down, uint8_t isMod, uint8_t value)
+{
+    uint16_t ticks = 0;
+    uint8_t hdr = (down ? MACRO_EVT_DOWN : 0) | (isMod ? MACRO_EVT_MOD : 0);
+    uint8_t need = 1;
+
+    if (macro.state != MACRO_RECORDING)
+    {
+        return;
+    }
+
+    // the first event plays right away
+    if (macro.len)
+    {
+        ticks = BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(macro.lastBtClk)) / MACRO_TICK_MS;
+        if (ticks > MACRO_DELAY_MAX)
+        {
+            ticks = MACRO_DELAY_MAX;
+        }
+    }
+
+    if (macro.len && (value == macro.prevValue))
+    {
+        hdr |= MACRO_EVT_REPEAT;
+    }
+    else
+    {
+        need++;
+    }
+    if (ticks >= MACRO_DELAY_EXT)
+    {
+        need++;
+    }
+
+    if (macro.len + need > MACRO_MAX_LEN)
+    {
+        MACRO_save();
+        return;
+    }
+
+    if (ticks >= MACRO_DELAY_EXT)
+    {
+        macro.buf[macro.len++] = hdr | MACRO_DELAY_EXT;
+        macro.buf[macro.len++] = ticks - MACRO_DELAY_EXT;
+    }
+    else
+    {
+        macro.buf[macro.len++] = hdr | ticks;
+    }
+    if (!(hdr & MACRO_EVT_REPEAT))
+    {
+        macro.buf[macro.len++] = value - macro.prevValue;
+    }
+    macro.prevValue = value;
+    macro.lastBtClk = wiced_hidd_get_current_native_bt_clocks();
+
+    // keys already down when recording started are released without a recorded press
+    if (down)
+    {
+        macro.keysDown++;
+    }
+    else if (macro.keysDown)
+    {
+        macro.keysDown--;
+    }
+    if (!macro.keysDown)
+    {
+        macro.balancedLen = macro.len;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void macro_poll(void)
+ ********************************************************************************
+ * Summary: Play the next macro event when it is due and the transport has room.
+ *          Called once per connection event, plays one event at most.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_poll(void)
+{
+    uint8_t hdr, value;
+    uint16_t ticks;
+    uint8_t n = 1;
+
+    // each event is sent on its own, it must not join a report still waiting
+    if ((macro.state != MACRO_PLAYING) || app.recoveryInProgress ||
+        key_sendPending() || !route_txReady())
+    {
+        return;
+    }
+
+    hdr = macro.buf[macro.pos];
+    ticks = hdr & MACRO_EVT_DELAY_MASK;
+    if (ticks == MACRO_DELAY_EXT)
+    {
+        n++;
+    }
+    if (!(hdr & MACRO_EVT_REPEAT))
+    {
+        n++;
+    }
+
+    // a record cut short in NVRAM ends the playback
+    if (macro.pos + n > macro.len)
+    {
+        macro.state = MACRO_IDLE;
+        return;
+    }
+    if (ticks == MACRO_DELAY_EXT)
+    {
+        ticks += macro.buf[macro.pos + 1];
+    }
+
+    if (BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(macro.lastBtClk)) < ticks * MACRO_TICK_MS)
+    {
+        return;
+    }
+
+    value = (hdr & MACRO_EVT_REPEAT) ? macro.prevValue : macro.prevValue + macro.buf[macro.pos + n - 1];
+    macro.prevValue = value;
+    macro.pos += n;
+    macro.lastBtClk = wiced_hidd_get_current_native_bt_clocks();
+
+    key_play((hdr & MACRO_EVT_MOD) ? KEY_TYPE_MODIFIER : KEY_TYPE_STD, value, (hdr & MACRO_EVT_DOWN) != 0);
+
+    if (macro.pos >= macro.len)
+    {
+        macro.state = MACRO_IDLE;
+    }
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t macro_store(uint8_t slot, const uint8_t *data, uint16_t len)
+ ********************************************************************************
+ * Summary: Replace the macro of a slot with an encoded macro built by the host
+ *
+ * Parameters:
+ *  slot -- macro slot
+ *  data -- encoded macro, same format as recorded
+ *  len -- data length, 0 to delete the macro
+ *
+ * Return:
+ *  TRUE if the macro is saved
+ *
+ *******************************************************************************/
+wiced_bool_t macro_store(uint8_t slot, const uint8_t *data, uint16_t len)
+{
+    wiced_result_t result;
+
+    if ((slot >= MACRO_SLOTS) || (len > MACRO_MAX_LEN) || (macro.state != MACRO_IDLE))
+    {
+        return FALSE;
+    }
+
+    if (len)
+    {
+        wiced_hal_write_nvram(VS_ID_MACRO + slot, len, (uint8_t *) data, &result);
+    }
+    else
+    {
+        wiced_hal_delete_nvram(VS_ID_MACRO + slot, &result);
+    }
+    return result == WICED_SUCCESS;
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t macro_playing(void)
+ ********************************************************************************
+ * Summary: Check if a macro is being played
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if playback is in progress
+ *
+ *******************************************************************************/
+wiced_bool_t macro_playing(void)
+{
+    return macro.state == MACRO_PLAYING;
+}
+
+/********************************************************************************
+ * Function Name: void macro_stop(void)
+ ********************************************************************************
+ * Summary: Abort the playback in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_stop(void)
+{
+    if (macro.state == MACRO_PLAYING)
+    {
+        macro.state = MACRO_IDLE;
+    }
+}
+
+#endif // SUPPORT_MACRO
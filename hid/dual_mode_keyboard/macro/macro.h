@@ -0,0 +1,166 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Macro recorder and paced playback
+ *
+ * The record key arms the recorder, the macro key pressed next selects the slot
+ * and the standard and modifier key events that follow are recorded until the
+ * record key is pressed again. Each slot is kept in its own NVRAM record.
+ *
+ */
+
+#ifndef __APP_MACRO_H__
+#define __APP_MACRO_H__
+
+#ifdef SUPPORT_MACRO
+#include "wiced.h"
+
+#define MACRO_SLOTS     3       // macro keys, one NVRAM record each starting at VS_ID_MACRO
+
+/********************************************************************************
+ * Function Name: void macro_recordKey(uint8_t down)
+ ********************************************************************************
+ * Summary: Record key event. Arms the recorder, or saves the macro being recorded.
+ *
+ * Parameters:
+ *  down -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_recordKey(uint8_t down);
+
+/********************************************************************************
+ * Function Name: void macro_key(uint8_t slot, uint8_t down)
+ ********************************************************************************
+ * Summary: Macro key event. Selects the slot to record when the recorder is armed,
+ *          otherwise starts the playback of the slot.
+ *
+ * Parameters:
+ *  slot -- macro slot, less than MACRO_SLOTS
+ *  down -- key up or down
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_key(uint8_t slot, uint8_t down);
+
+/********************************************************************************
+ * Function Name: void macro_record(uint8_t down, uint8_t isMod, uint8_t value)
+ ********************************************************************************
+ * Summary: Add a key event to the macro being recorded. Ignored when not recording.
+ *
+ * Parameters:
+ *  down -- key up or down
+ *  isMod -- TRUE if value is a modifier mask, FALSE if it is a standard key usage
+ *  value -- usage or modifier mask
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_record(uint8_t down, uint8_t isMod, uint8_t value);
+
+/********************************************************************************
+ * Function Name: void macro_poll(void)
+ ********************************************************************************
+ * Summary: Play the next macro event when it is due and the transport has room.
+ *          Called once per connection event, plays one event at most.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_poll(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t macro_store(uint8_t slot, const uint8_t *data, uint16_t len)
+ ********************************************************************************
+ * Summary: Replace the macro of a slot with an encoded macro built by the host
+ *
+ * Parameters:
+ *  slot -- macro slot
+ *  data -- encoded macro, same format as recorded
+ *  len -- data length, 0 to delete the macro
+ *
+ * Return:
+ *  TRUE if the macro is saved
+ *
+ *******************************************************************************/
+wiced_bool_t macro_store(uint8_t slot, const uint8_t *data, uint16_t len);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t macro_playing(void)
+ ********************************************************************************
+ * Summary: Check if a macro is being played
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if playback is in progress
+ *
+ *******************************************************************************/
+wiced_bool_t macro_playing(void);
+
+/********************************************************************************
+ * Function Name: void macro_stop(void)
+ ********************************************************************************
+ * Summary: Abort the playback in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void macro_stop(void);
+
+#else
+# define macro_recordKey(d)
+# define macro_key(s,d)
+# define macro_record(d,m,v)
+# define macro_poll()
+# define macro_playing() FALSE
+# define macro_store(s,d,l) FALSE
+# define macro_stop()
+#endif
+#endif // __APP_MACRO_H__
@@ -0,0 +1,982 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * OTA firmware upgrade receiver
+ *
+ * The image is received through the OTA data characteristic and streamed to the
+ * upgrade partition. Incoming data is collected into one of two chunk buffers.
+ * When a buffer is full it is handed to the application thread to be programmed
+ * while the other buffer keeps receiving, and the flash sector ahead of the
+ * write pointer is erased in the same step so no bulk erase is needed up front.
+ *
+ * The image digest (SHA-256 for secure upgrade, CRC32 otherwise) is updated one
+ * chunk at a time as it is programmed, so verification at the end is a single
+ * finalization instead of a read back of the whole partition.
+ *
+ * Every time a flash sector is completed, the sector bitmap and the running
+ * digest are saved in NVRAM. If the link drops, the next DOWNLOAD of the same
+ * image restores them and the host asks for the resume offset to continue
+ * from there instead of restarting from zero.
+ *
+ * The image may also be sent compressed. A compressed image starts with an
+ * ota_stream_hdr_t header and is decoded on the fly with a 512 byte window
+ * straight into the chunk buffers, so the digest and the ECDSA signature are
+ * checked against the reconstructed firmware. The LZSS stream is a flag byte
+ * for each group of 8 tokens, LSB first. A set flag is a literal byte, a
+ * clear flag is a 2 byte little endian back reference: bits 0-8 distance-1,
+ * bits 9-15 length-OTA_LZ_MIN_MATCH. Compressed transfers are not resumable.
+ *
+ */
+
+#ifdef APP_OTA_FW_UPGRADE
+#include "app.h"
+#include "wiced_rtos.h"
+#include "wiced_firmware_upgrade.h"
+#include "wiced_hal_nvram.h"
+#ifdef APP_OTA_SEC_FW_UPGRADE
+ #include "sha2.h"
+ #include "p_256_ecdsa.h"
+#endif
+
+#define OTA_CHUNK_SIZE              512     // flash program unit, 2 x 512 bytes of RAM
+#define OTA_SECTOR_SIZE             4096    // flash erase unit
+#define OTA_SIGNATURE_LEN           64      // ECDSA P-256 signature appended to secure images
+
+#define OTA_MAX_SECTORS             64      // largest image handled by the resume bitmap, 256 KB
+
+#define OTA_STREAM_MAGIC            0x5a41544f  // "OTAZ"
+#define OTA_LZ_WINDOW_SIZE          512     // must be a power of 2, matches the 9 bit distance
+#define OTA_LZ_MIN_MATCH            3
+
+typedef enum {
+    OTA_FORMAT_UNKNOWN,                     // waiting for the stream header
+    OTA_FORMAT_RAW,                         // plain image
+    OTA_FORMAT_LZSS,                        // LZSS compressed image
+} ota_format_e;
+
+typedef enum {
+    OTA_LZ_FLAG,                            // next byte is a flag byte
+    OTA_LZ_TOKEN,                           // next byte is a literal or the low byte of a reference
+    OTA_LZ_REF,                             // next byte is the high byte of a reference
+} ota_lz_state_e;
+
+// vendor control point commands, beyond the WICED_OTA_UPGRADE_COMMAND_xxx set
+#define OTA_COMMAND_GET_THROUGHPUT  0x20    // response: status, uint32 bytes/s
+#define OTA_COMMAND_GET_RESUME_OFFSET 0x21  // response: status, uint32 offset to send the image from
+
+/// Resume record saved in NVRAM at each completed sector
+#pragma pack(1)
+/// Compressed image header
+typedef PACKED struct {
+    uint32_t magic;                         // OTA_STREAM_MAGIC
+    uint8_t  format;                        // ota_format_e
+    uint8_t  reserved[3];
+    uint32_t outputLen;                     // firmware length after decoding
+} ota_stream_hdr_t;
+
+typedef PACKED struct {
+    uint32_t imageLen;                      // image length given in DOWNLOAD
+    uint32_t imageId;                       // optional image id given in DOWNLOAD
+    uint8_t  sectorMap[OTA_MAX_SECTORS/8];  // committed sectors
+#ifdef APP_OTA_SEC_FW_UPGRADE
+    sha2_context sha2;                      // digest state after the committed sectors
+#else
+    uint32_t crc32;
+#endif
+} ota_resume_t;
+#pragma pack()
+
+typedef enum {
+    OTA_STATE_IDLE,
+    OTA_STATE_READY_FOR_DOWNLOAD,
+    OTA_STATE_DATA_TRANSFER,
+    OTA_STATE_VERIFIED,
+} ota_state_e;
+
+typedef struct {
+    uint8_t  state;
+    uint8_t  nvLocated;                     // upgrade partition located, TRUE when an image can be received
+    uint16_t cccd;
+
+    uint32_t imageLen;                      // total image length, signature included
+    uint32_t inLen;                         // image length, signature excluded
+    uint32_t fwLen;                         // firmware length programmed to flash
+    uint32_t rxOffset;                      // image bytes received
+    uint32_t outOffset;                     // firmware bytes decoded into the chunk buffers
+    uint32_t nvOffset;                      // firmware bytes programmed
+    uint32_t erasedOffset;                  // upgrade partition erased up to here
+    uint32_t startBtClk;                    // BT clock at the start of the data transfer
+    uint32_t startOffset;                   // image offset at the start of the data transfer
+    ota_resume_t resume;
+
+    uint8_t  buf[2][OTA_CHUNK_SIZE];
+    uint16_t bufLen[2];
+    uint8_t  fillIdx;                       // buffer receiving data, the other one may wait for programming
+    uint8_t  programPending:1;
+    uint8_t  programFailed:1;
+
+    uint8_t  format;                        // ota_format_e
+    ota_stream_hdr_t hdr;
+
+    // LZSS decoder
+    uint8_t  window[OTA_LZ_WINDOW_SIZE];
+    uint16_t windowPos;
+    uint8_t  lzState;
+    uint8_t  lzFlags;
+    uint8_t  lzFlagBits;
+    uint8_t  lzRefLo;
+
+#ifdef APP_OTA_SEC_FW_UPGRADE
+    sha2_context sha2;
+    uint8_t  signature[OTA_SIGNATURE_LEN];
+#else
+    uint32_t crc32;
+#endif
+} ota_data_t;
+
+static ota_data_t ota = {};
+
+#ifdef APP_OTA_SEC_FW_UPGRADE
+extern Point ecdsa256_public_key;
+#endif
+
+/********************************************************************************
+ * Function Name: OTA_sendResponse
+ ********************************************************************************
+ * Summary: send command status and optional data to the host through the
+ *          control point
+ *
+ * Parameters:
+ *  status -- WICED_OTA_UPGRADE_STATUS_xxx
+ *  value -- 32-bit value following the status
+ *  withValue -- TRUE to include value in the response
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_sendResponse(uint8_t status, uint32_t value, wiced_bool_t withValue)
+{
+    uint8_t rsp[5] = {status, value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >> 24) & 0xff};
+    uint16_t len = withValue ? sizeof(rsp) : 1;
+
+    if (ota.cccd & GATT_CLIENT_CONFIG_INDICATION)
+    {
+        wiced_bt_gatt_send_indication(hidd_blelink.gatts_conn_id, HANDLE_OTA_FW_UPGRADE_CONTROL_POINT, len, rsp);
+    }
+    else if (ota.cccd & GATT_CLIENT_CONFIG_NOTIFICATION)
+    {
+        wiced_bt_gatt_send_notification(hidd_blelink.gatts_conn_id, HANDLE_OTA_FW_UPGRADE_CONTROL_POINT, len, rsp);
+    }
+}
+
+#define OTA_sendStatus(s) OTA_sendResponse(s, 0, FALSE)
+
+/********************************************************************************
+ * Function Name: OTA_throughput
+ ********************************************************************************
+ * Summary: get image data throughput since the start of the data transfer
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  throughput in bytes/s
+ *
+ *******************************************************************************/
+STATIC uint32_t OTA_throughput(void)
+{
+    uint32_t elapsed_ms = BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(ota.startBtClk));
+
+    return elapsed_ms ? ((ota.rxOffset - ota.startOffset) * 1000) / elapsed_ms : 0;
+}
+
+/********************************************************************************
+ * Function Name: OTA_resumeOffset
+ ********************************************************************************
+ * Summary: get the image offset right after the last committed sector
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  offset in bytes
+ *
+ *******************************************************************************/
+STATIC uint32_t OTA_resumeOffset(void)
+{
+    uint8_t sector = 0;
+
+    while ((sector < OTA_MAX_SECTORS) && (ota.resume.sectorMap[sector/8] & (1 << (sector%8))))
+    {
+        sector++;
+    }
+    return sector * OTA_SECTOR_SIZE;
+}
+
+/********************************************************************************
+ * Function Name: OTA_resumeSave
+ ********************************************************************************
+ * Summary: mark the sector committed and save the resume record with the
+ *          current digest state
+ *
+ * Parameters:
+ *  sector -- sector index
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_resumeSave(uint8_t sector)
+{
+    wiced_result_t result;
+
+    if (sector >= OTA_MAX_SECTORS)
+    {
+        return;
+    }
+
+    ota.resume.sectorMap[sector/8] |= 1 << (sector%8);
+#ifdef APP_OTA_SEC_FW_UPGRADE
+    memcpy(&ota.resume.sha2, &ota.sha2, sizeof(sha2_context));
+#else
+    ota.resume.crc32 = ota.crc32;
+#endif
+    wiced_hal_write_nvram(VS_ID_OTA_RESUME, sizeof(ota_resume_t), (uint8_t *) &ota.resume, &result);
+}
+
+/********************************************************************************
+ * Function Name: OTA_resumeClear
+ ********************************************************************************
+ * Summary: forget the saved upgrade, next DOWNLOAD starts from zero
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_resumeClear(void)
+{
+    wiced_result_t result;
+
+    memset(&ota.resume, 0, sizeof(ota_resume_t));
+    wiced_hal_delete_nvram(VS_ID_OTA_RESUME, &result);
+}
+
+/********************************************************************************
+ * Function Name: OTA_resumeRestore
+ ********************************************************************************
+ * Summary: restore the saved upgrade if it is for the same image
+ *
+ * Parameters:
+ *  imageLen -- image length given in DOWNLOAD
+ *  imageId -- image id given in DOWNLOAD, 0 if none
+ *
+ * Return:
+ *  TRUE if the transfer continues from a saved offset
+ *
+ *******************************************************************************/
+STATIC wiced_bool_t OTA_resumeRestore(uint32_t imageLen, uint32_t imageId)
+{
+    wiced_result_t result;
+    uint32_t offset;
+
+    if ((wiced_hal_read_nvram(VS_ID_OTA_RESUME, sizeof(ota_resume_t), (uint8_t *) &ota.resume, &result) == sizeof(ota_resume_t))
+        && (result == WICED_SUCCESS)
+        && (ota.resume.imageLen == imageLen) && (ota.resume.imageId == imageId))
+    {
+        offset = OTA_resumeOffset();
+        if (offset && (offset < ota.fwLen))
+        {
+#ifdef APP_OTA_SEC_FW_UPGRADE
+            memcpy(&ota.sha2, &ota.resume.sha2, sizeof(sha2_context));
+#else
+            ota.crc32 = ota.resume.crc32;
+#endif
+            ota.rxOffset = ota.outOffset = ota.nvOffset = ota.erasedOffset = offset;
+            ota.format = OTA_FORMAT_RAW;
+            return TRUE;
+        }
+    }
+
+    // different image or nothing saved, start over
+    memset(&ota.resume, 0, sizeof(ota_resume_t));
+    ota.resume.imageLen = imageLen;
+    ota.resume.imageId = imageId;
+    return FALSE;
+}
+
+/********************************************************************************
+ * Function Name: OTA_reset
+ ********************************************************************************
+ * Summary: drop any upgrade in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_reset(void)
+{
+    // release the fast link once the upgrade is over, a keymap upload may still hold it
+    if (ota.state != OTA_STATE_IDLE)
+    {
+        ble_set_link_profile(BLE_LINK_PROFILE_TYPING);
+    }
+
+    ota.state = OTA_STATE_IDLE;
+    ota.imageLen = ota.inLen = ota.fwLen = ota.rxOffset = ota.outOffset = ota.nvOffset = ota.erasedOffset = 0;
+    ota.format = OTA_FORMAT_UNKNOWN;
+    ota.bufLen[0] = ota.bufLen[1] = 0;
+    ota.fillIdx = 0;
+    ota.programPending = ota.programFailed = FALSE;
+}
+
+/********************************************************************************
+ * Function Name: OTA_programChunk
+ ********************************************************************************
+ * Summary: program the buffer waiting for flash and fold it into the digest.
+ *          Called from the application thread, so the stack can keep receiving
+ *          into the other buffer.
+ *
+ * Parameters:
+ *  data -- not used
+ *
+ * Return:
+ *  0
+ *
+ *******************************************************************************/
+STATIC int OTA_programChunk(void * data)
+{
+    uint8_t  idx = ota.fillIdx ^ 1;
+    uint16_t len = ota.bufLen[idx];
+
+    if (!ota.programPending || (ota.state != OTA_STATE_DATA_TRANSFER))
+    {
+        return 0;
+    }
+
+    // keep one sector erased ahead of the write pointer
+    while ((ota.erasedOffset < ota.nvOffset + len + OTA_SECTOR_SIZE) && (ota.erasedOffset < ota.fwLen))
+    {
+        wiced_firmware_upgrade_erase_nv(ota.erasedOffset, OTA_SECTOR_SIZE);
+        ota.erasedOffset += OTA_SECTOR_SIZE;
+    }
+
+    if (wiced_firmware_upgrade_store_to_nv(ota.nvOffset, ota.buf[idx], len) != len)
+    {
+        WICED_BT_TRACE("\nOTA program failed at %d", ota.nvOffset);
+        ota.programFailed = TRUE;
+    }
+
+#ifdef APP_OTA_SEC_FW_UPGRADE
+    sha2_update(&ota.sha2, ota.buf[idx], len);
+#else
+    ota.crc32 = app_crc32Update(ota.crc32, ota.buf[idx], len);
+#endif
+
+    ota.nvOffset += len;
+    ota.bufLen[idx] = 0;
+    ota.programPending = FALSE;
+
+    // sector completed, save where we are in case the link drops
+    if (!ota.programFailed && (ota.format == OTA_FORMAT_RAW) && (!(ota.nvOffset % OTA_SECTOR_SIZE) || (ota.nvOffset == ota.fwLen)))
+    {
+        OTA_resumeSave((ota.nvOffset - 1) / OTA_SECTOR_SIZE);
+    }
+    return 0;
+}
+
+/********************************************************************************
+ * Function Name: OTA_submitChunk
+ ********************************************************************************
+ * Summary: hand the filled buffer over for programming and switch to the other one
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_submitChunk(void)
+{
+    // the previous chunk is still waiting, flush it now to free its buffer
+    if (ota.programPending)
+    {
+        OTA_programChunk(NULL);
+    }
+
+    ota.fillIdx ^= 1;
+    ota.programPending = TRUE;
+
+    if (!wiced_app_event_serialize(OTA_programChunk, NULL))
+    {
+        OTA_programChunk(NULL);
+    }
+}
+
+/********************************************************************************
+ * Function Name: OTA_output
+ ********************************************************************************
+ * Summary: append firmware bytes to the chunk buffers, hand full buffers over
+ *          for programming
+ *
+ * Parameters:
+ *  p -- firmware data
+ *  len -- data length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_output(const uint8_t * p, uint16_t len)
+{
+    uint16_t n;
+
+    while (len)
+    {
+        n = OTA_CHUNK_SIZE - ota.bufLen[ota.fillIdx];
+        if (n > len)
+        {
+            n = len;
+        }
+        if (n > ota.fwLen - ota.outOffset)
+        {
+            n = ota.fwLen - ota.outOffset;
+        }
+        if (!n)
+        {
+            // more data than the image length, the image is bad
+            ota.programFailed = TRUE;
+            return;
+        }
+
+        memcpy(&ota.buf[ota.fillIdx][ota.bufLen[ota.fillIdx]], p, n);
+        ota.bufLen[ota.fillIdx] += n;
+        ota.outOffset += n;
+        p += n;
+        len -= n;
+
+        if ((ota.bufLen[ota.fillIdx] == OTA_CHUNK_SIZE) || (ota.outOffset == ota.fwLen))
+        {
+            OTA_submitChunk();
+        }
+    }
+}
+
+/********************************************************************************
+ * Function Name: OTA_lzPut
+ ********************************************************************************
+ * Summary: output one decoded byte and keep it in the window
+ *
+ * Parameters:
+ *  b -- decoded byte
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_lzPut(uint8_t b)
+{
+    ota.window[ota.windowPos++ & (OTA_LZ_WINDOW_SIZE - 1)] = b;
+    OTA_output(&b, 1);
+}
+
+/********************************************************************************
+ * Function Name: OTA_lzNextToken
+ ********************************************************************************
+ * Summary: move to the next flag bit
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_lzNextToken(void)
+{
+    ota.lzFlags >>= 1;
+    ota.lzState = --ota.lzFlagBits ? OTA_LZ_TOKEN : OTA_LZ_FLAG;
+}
+
+/********************************************************************************
+ * Function Name: OTA_lzDecode
+ ********************************************************************************
+ * Summary: decode LZSS stream data. The decoder state is kept between calls,
+ *          tokens may span GATT writes.
+ *
+ * Parameters:
+ *  p -- compressed data
+ *  len -- data length
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_lzDecode(const uint8_t * p, uint16_t len)
+{
+    uint16_t ref, dist, count;
+    uint8_t b;
+
+    while (len--)
+    {
+        b = *p++;
+        switch (ota.lzState) {
+        case OTA_LZ_FLAG:
+            ota.lzFlags = b;
+            ota.lzFlagBits = 8;
+            ota.lzState = OTA_LZ_TOKEN;
+            break;
+
+        case OTA_LZ_TOKEN:
+            if (ota.lzFlags & 1)
+            {
+                OTA_lzPut(b);
+                OTA_lzNextToken();
+            }
+            else
+            {
+                ota.lzRefLo = b;
+                ota.lzState = OTA_LZ_REF;
+            }
+            break;
+
+        case OTA_LZ_REF:
+            ref = ota.lzRefLo | (b << 8);
+            dist = (ref & (OTA_LZ_WINDOW_SIZE - 1)) + 1;
+            count = (ref >> 9) + OTA_LZ_MIN_MATCH;
+            while (count--)
+            {
+                OTA_lzPut(ota.window[(ota.windowPos - dist) & (OTA_LZ_WINDOW_SIZE - 1)]);
+            }
+            OTA_lzNextToken();
+            break;
+        }
+    }
+}
+
+/********************************************************************************
+ * Function Name: OTA_parseHeader
+ ********************************************************************************
+ * Summary: check the first image bytes for a stream header. Without one, the
+ *          collected bytes are the start of a plain image.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void OTA_parseHeader(void)
+{
+    if ((ota.rxOffset == sizeof(ota_stream_hdr_t)) && (ota.hdr.magic == OTA_STREAM_MAGIC))
+    {
+        if ((ota.hdr.format != OTA_FORMAT_LZSS) || !ota.hdr.outputLen || (ota.hdr.outputLen > OTA_MAX_SECTORS * OTA_SECTOR_SIZE))
+        {
+            WICED_BT_TRACE("\nOTA unsupported image format %d", ota.hdr.format);
+            ota.programFailed = TRUE;
+            ota.format = OTA_FORMAT_RAW;
+            ota.fwLen = 0;
+            return;
+        }
+
+        WICED_BT_TRACE("\nOTA compressed image, %d bytes decoded", ota.hdr.outputLen);
+        ota.format = OTA_FORMAT_LZSS;
+        ota.fwLen = ota.hdr.outputLen;
+        ota.lzState = OTA_LZ_FLAG;
+        ota.windowPos = 0;
+        memset(ota.window, 0, sizeof(ota.window));
+    }
+    else
+    {
+        ota.format = OTA_FORMAT_RAW;
+        OTA_output((uint8_t *) &ota.hdr, ota.rxOffset);
+    }
+}
+
+/********************************************************************************
+ * Function Name: OTA_verify
+ ********************************************************************************
+ * Summary: finalize the digest and check the image
+ *
+ * Parameters:
+ *  crc -- CRC32 given by the host, not used for secure upgrade
+ *
+ * Return:
+ *  TRUE if the image is good
+ *
+ *******************************************************************************/
+STATIC wiced_bool_t OTA_verify(uint32_t crc)
+{
+    // program what is left in the buffers
+    OTA_programChunk(NULL);
+    if (ota.bufLen[ota.fillIdx])
+    {
+        OTA_submitChunk();
+        OTA_programChunk(NULL);
+    }
+
+    if (ota.programFailed || (ota.rxOffset != ota.imageLen) || (ota.nvOffset != ota.fwLen)
+        || (ota.format == OTA_FORMAT_UNKNOWN) || ((ota.format == OTA_FORMAT_LZSS) && (ota.lzState == OTA_LZ_REF)))
+    {
+        return FALSE;
+    }
+
+#ifdef APP_OTA_SEC_FW_UPGRADE
+    {
+        uint8_t digest[32];
+
+        sha2_finish(&ota.sha2, digest);
+        return ecdsa_verify_(digest, ota.signature, &ecdsa256_public_key) ? TRUE : FALSE;
+    }
+#else
+    return (ota.crc32 ^ 0xffffffff) == crc;
+#endif
+}
+
+/********************************************************************************
+ * Function Name: void ota_init(void)
+ ********************************************************************************
+ * Summary: Locate the upgrade partition. The image is received by this module,
+ *          not by the OTA library, so nothing else sets up the partition.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_init(void)
+{
+    ota.nvLocated = wiced_firmware_upgrade_init_nv_locations();
+    if (!ota.nvLocated)
+    {
+        WICED_BT_TRACE("\nOTA upgrade partition not found");
+    }
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t ota_is_active(void)
+ ********************************************************************************
+ * Summary: Check if firmware upgrade is in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if an upgrade has been prepared and not yet finished or aborted
+ *
+ *******************************************************************************/
+wiced_bool_t ota_is_active(void)
+{
+    return ota.state != OTA_STATE_IDLE;
+}
+
+/********************************************************************************
+ * Function Name: void ota_controlPointWrite()
+ ********************************************************************************
+ * Summary: OTA control point write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- command followed by its parameters
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_controlPointWrite(wiced_hidd_report_type_t reportType,
+                           uint8_t reportId,
+                           void *payload,
+                           uint16_t payloadSize)
+{
+    uint8_t * p = (uint8_t *) payload;
+    uint8_t status = WICED_OTA_UPGRADE_STATUS_OK;
+    uint32_t param = 0;
+
+    if (!payloadSize)
+    {
+        return;
+    }
+    if (payloadSize >= 5)
+    {
+        param = p[1] | (p[2] << 8) | (p[3] << 16) | (p[4] << 24);
+    }
+
+    switch (p[0]) {
+    case WICED_OTA_UPGRADE_COMMAND_PREPARE_DOWNLOAD:
+        if (!ota.nvLocated)
+        {
+            status = WICED_OTA_UPGRADE_STATUS_ILLEGAL_STATE;
+            break;
+        }
+        OTA_reset();
+        ota.state = OTA_STATE_READY_FOR_DOWNLOAD;
+        ble_set_link_profile(BLE_LINK_PROFILE_OTA);
+        WICED_BT_TRACE("\nOTA prepare");
+        break;
+
+    case WICED_OTA_UPGRADE_COMMAND_DOWNLOAD:
+#ifdef APP_OTA_SEC_FW_UPGRADE
+        if ((ota.state != OTA_STATE_READY_FOR_DOWNLOAD) || (param <= OTA_SIGNATURE_LEN))
+#else
+        if ((ota.state != OTA_STATE_READY_FOR_DOWNLOAD) || !param)
+#endif
+        {
+            status = WICED_OTA_UPGRADE_STATUS_ILLEGAL_STATE;
+            break;
+        }
+        ota.imageLen = param;
+#ifdef APP_OTA_SEC_FW_UPGRADE
+        ota.inLen = param - OTA_SIGNATURE_LEN;
+        sha2_starts(&ota.sha2, 0);
+#else
+        ota.inLen = param;
+        ota.crc32 = 0xffffffff;
+#endif
+        // plain image unless the stream header says otherwise
+        ota.fwLen = ota.inLen;
+        if (ota.fwLen > OTA_MAX_SECTORS * OTA_SECTOR_SIZE)
+        {
+            status = WICED_OTA_UPGRADE_STATUS_INVALID_IMAGE_SIZE;
+            break;
+        }
+        // optional image id follows the length, used to match a saved upgrade
+        OTA_resumeRestore(param, payloadSize >= 9 ? p[5] | (p[6] << 8) | (p[7] << 16) | (p[8] << 24) : 0);
+
+        ota.state = OTA_STATE_DATA_TRANSFER;
+        ota.startBtClk = wiced_hidd_get_current_native_bt_clocks();
+        ota.startOffset = ota.rxOffset;
+        WICED_BT_TRACE("\nOTA download %d bytes from %d", param, ota.rxOffset);
+        break;
+
+    case OTA_COMMAND_GET_RESUME_OFFSET:
+        if (ota.state != OTA_STATE_DATA_TRANSFER)
+        {
+            status = WICED_OTA_UPGRADE_STATUS_ILLEGAL_STATE;
+            break;
+        }
+        OTA_sendResponse(status, ota.rxOffset, TRUE);
+        return;
+
+    case WICED_OTA_UPGRADE_COMMAND_VERIFY:
+        if (ota.state != OTA_STATE_DATA_TRANSFER)
+        {
+            status = WICED_OTA_UPGRADE_STATUS_ILLEGAL_STATE;
+        }
+        else if (OTA_verify(param))
+        {
+            WICED_BT_TRACE("\nOTA verified, %d bytes/s", OTA_throughput());
+            OTA_resumeClear();
+            ota.state = OTA_STATE_VERIFIED;
+        }
+        else
+        {
+            WICED_BT_TRACE("\nOTA verification failed");
+            OTA_resumeClear();
+            OTA_reset();
+            status = WICED_OTA_UPGRADE_STATUS_VERIFICATION_FAILED;
+        }
+        break;
+
+    case WICED_OTA_UPGRADE_COMMAND_FINISH:
+        if (ota.state != OTA_STATE_VERIFIED)
+        {
+            status = WICED_OTA_UPGRADE_STATUS_ILLEGAL_STATE;
+            break;
+        }
+        WICED_BT_TRACE("\nOTA finish, switching image");
+        OTA_sendStatus(status);
+        wiced_firmware_upgrade_finish();
+        return;
+
+    case OTA_COMMAND_GET_THROUGHPUT:
+        OTA_sendResponse(status, OTA_throughput(), TRUE);
+        return;
+
+    case WICED_OTA_UPGRADE_COMMAND_ABORT:
+        WICED_BT_TRACE("\nOTA abort");
+        OTA_resumeClear();
+        OTA_reset();
+        break;
+
+    default:
+        status = WICED_OTA_UPGRADE_STATUS_UNSUPPORTED_COMMAND;
+        break;
+    }
+
+    OTA_sendStatus(status);
+}
+
+/********************************************************************************
+ * Function Name: void ota_clientConfWrite()
+ ********************************************************************************
+ * Summary: OTA control point client configuration write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- client configuration value
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_clientConfWrite(wiced_hidd_report_type_t reportType,
+                         uint8_t reportId,
+                         void *payload,
+                         uint16_t payloadSize)
+{
+    if (payloadSize >= sizeof(uint16_t))
+    {
+        ota.cccd = *(uint16_t *)payload;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void ota_dataWrite()
+ ********************************************************************************
+ * Summary: OTA data write handler. Image data is double buffered and programmed
+ *          to flash while the next chunk is being received.
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- image data
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_dataWrite(wiced_hidd_report_type_t reportType,
+                   uint8_t reportId,
+                   void *payload,
+                   uint16_t payloadSize)
+{
+    uint8_t * p = (uint8_t *) payload;
+    uint16_t len;
+
+    if ((ota.state != OTA_STATE_DATA_TRANSFER) || (ota.rxOffset + payloadSize > ota.imageLen))
+    {
+        OTA_sendStatus(WICED_OTA_UPGRADE_STATUS_ILLEGAL_STATE);
+        return;
+    }
+
+    while (payloadSize)
+    {
+#ifdef APP_OTA_SEC_FW_UPGRADE
+        // the signature trailing the firmware is kept aside, not programmed
+        if (ota.rxOffset >= ota.inLen)
+        {
+            memcpy(&ota.signature[ota.rxOffset - ota.inLen], p, payloadSize);
+            ota.rxOffset += payloadSize;
+            break;
+        }
+#endif
+        len = payloadSize;
+        if (len > ota.inLen - ota.rxOffset)
+        {
+            len = ota.inLen - ota.rxOffset;
+        }
+
+        if (ota.format == OTA_FORMAT_UNKNOWN)
+        {
+            // collect the stream header first
+            if (len > sizeof(ota_stream_hdr_t) - ota.rxOffset)
+            {
+                len = sizeof(ota_stream_hdr_t) - ota.rxOffset;
+            }
+            memcpy((uint8_t *) &ota.hdr + ota.rxOffset, p, len);
+            ota.rxOffset += len;
+
+            if ((ota.rxOffset == sizeof(ota_stream_hdr_t)) || (ota.rxOffset == ota.inLen))
+            {
+                OTA_parseHeader();
+            }
+        }
+        else
+        {
+            if (ota.format == OTA_FORMAT_LZSS)
+            {
+                OTA_lzDecode(p, len);
+            }
+            else
+            {
+                OTA_output(p, len);
+            }
+            ota.rxOffset += len;
+        }
+
+        p += len;
+        payloadSize -= len;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void ota_disconnected(void)
+ ********************************************************************************
+ * Summary: LE link is down, suspend the upgrade in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_disconnected(void)
+{
+    if (ota_is_active())
+    {
+        // program what was received, the resume record covers completed sectors
+        OTA_programChunk(NULL);
+        WICED_BT_TRACE("\nOTA suspended by disconnection at %d", ota.nvOffset);
+        OTA_reset();
+    }
+}
+
+#endif // APP_OTA_FW_UPGRADE
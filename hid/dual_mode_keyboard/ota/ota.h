@@ -40,11 +40,117 @@
 #ifndef __APP_OTAFWU_H__
 #define __APP_OTAFWU_H__
 
-#ifdef OTA_FIRMWARE_UPGRADE
+#ifdef APP_OTA_FW_UPGRADE
 # include "wiced.h"
 # include "wiced_bt_ota_firmware_upgrade.h"
-# define ota_is_active() wiced_ota_fw_upgrade_is_active()
+
+/********************************************************************************
+ * Function Name: void ota_init(void)
+ ********************************************************************************
+ * Summary: Locate the upgrade partition
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_init(void);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t ota_is_active(void)
+ ********************************************************************************
+ * Summary: Check if firmware upgrade is in progress
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if an upgrade has been prepared and not yet finished or aborted
+ *
+ *******************************************************************************/
+wiced_bool_t ota_is_active(void);
+
+/********************************************************************************
+ * Function Name: void ota_controlPointWrite()
+ ********************************************************************************
+ * Summary: OTA control point write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- command followed by its parameters
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_controlPointWrite(wiced_hidd_report_type_t reportType,
+                           uint8_t reportId,
+                           void *payload,
+                           uint16_t payloadSize);
+
+/********************************************************************************
+ * Function Name: void ota_clientConfWrite()
+ ********************************************************************************
+ * Summary: OTA control point client configuration write handler
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- client configuration value
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_clientConfWrite(wiced_hidd_report_type_t reportType,
+                         uint8_t reportId,
+                         void *payload,
+                         uint16_t payloadSize);
+
+/********************************************************************************
+ * Function Name: void ota_dataWrite()
+ ********************************************************************************
+ * Summary: OTA data write handler. Image data is double buffered and programmed
+ *          to flash while the next chunk is being received.
+ *
+ * Parameters:
+ *  reportType -- not used
+ *  reportId -- not used
+ *  payload -- image data
+ *  payloadSize -- payload size
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_dataWrite(wiced_hidd_report_type_t reportType,
+                   uint8_t reportId,
+                   void *payload,
+                   uint16_t payloadSize);
+
+/********************************************************************************
+ * Function Name: void ota_disconnected(void)
+ ********************************************************************************
+ * Summary: LE link is down, suspend the upgrade in progress. It can be resumed
+ *          by the next DOWNLOAD of the same image.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void ota_disconnected(void);
+
 #else
+# define ota_init()
 # define ota_is_active() FALSE
+# define ota_disconnected()
 #endif
-#endif // __APP_BATTERY_H__
+#endif // __APP_OTAFWU_H__
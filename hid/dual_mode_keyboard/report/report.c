@@ -0,0 +1,227 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Report registry
+ *
+ * The registry is indexed directly by report type and report ID, so a lookup
+ * is one table load. The index tables are const and stay in flash.
+ *
+ */
+
+#include "app.h"
+
+/********************************************************************************
+ * Report registry
+ ********************************************************************************/
+const report_entry_t report_table[RPT_IDX_MAX] =
+{
+    [RPT_IDX_STD_KEY] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_STD_KEY,
+        .size       = sizeof(KeyboardStandardReport),
+        .cccdBitmap = APP_CLIENT_CONFIG_NOTIF_STD_RPT,
+        .data       = &key_snapshot.stdRpt,
+    },
+
+    [RPT_IDX_KB_LED] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_OUTPUT,
+        .id         = RPT_ID_OUT_KB_LED,
+        .size       = sizeof(KeyboardLedReport),
+        .data       = &key_rpts.ledReport,
+        .set        = key_setReport,
+    },
+
+    [RPT_IDX_BATTERY] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_BATTERY,
+        .size       = sizeof(BatteryReport),
+        .cccdBitmap = APP_CLIENT_CONFIG_NOTIF_BATTERY_RPT,
+        .data       = &batRpt,
+    },
+
+    [RPT_IDX_BIT_MAPPED] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_BIT_MAPPED,
+        .size       = sizeof(KeyboardBitMappedReport),
+        .cccdBitmap = APP_CLIENT_CONFIG_NOTIF_BIT_MAPPED_RPT,
+        .data       = &key_snapshot.bitMappedReport,
+    },
+
+    [RPT_IDX_SLEEP] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_SLEEP,
+        .size       = sizeof(KeyboardSleepReport),
+        .cccdBitmap = APP_CLIENT_CONFIG_NOTIF_SLP_RPT,
+        .data       = &key_snapshot.sleepReport,
+    },
+
+    [RPT_IDX_FUNC_LOCK] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_FUNC_LOCK,
+        .size       = sizeof(KeyboardFuncLockReport),
+        .cccdBitmap = APP_CLIENT_CONFIG_NOTIF_FUNC_LOCK_RPT,
+        .data       = &key_snapshot.funcLockReport,
+    },
+
+    [RPT_IDX_SCROLL] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_SCROLL,
+        .size       = sizeof(KeyboardMotionReport),
+        .cccdBitmap = APP_CLIENT_CONFIG_NOTIF_SCROLL_RPT,
+        .data       = &key_snapshot.scrollReport,
+    },
+
+    [RPT_IDX_CONSUMER] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_CONSUMER,
+        .size       = sizeof(KeyboardConsumerReport),
+        .cccdBitmap = APP_CLIENT_CONFIG_NOTIF_CONSUMER_RPT,
+        .data       = &key_snapshot.consumerReport,
+    },
+
+#ifdef SUPPORT_CODE_ENTRY
+    [RPT_IDX_PIN] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_INPUT,
+        .id         = RPT_ID_IN_PIN,
+        .size       = sizeof(KeyboardPinEntryReport),
+        .data       = &key_snapshot.pinReport,
+    },
+#endif
+
+    // connection control feature, write only
+    [RPT_IDX_CNT_CTL] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_FEATURE,
+        .id         = RPT_ID_FEATURE_CNT_CTL,
+        .size       = 2,
+        .set        = app_setConnectionCtrl,
+    },
+
+#ifdef SUPPORT_KEY_STATS
+    // key statistics feature, write the page number then read the page
+    [RPT_IDX_KEY_STATS] =
+    {
+        .type       = WICED_HID_REPORT_TYPE_FEATURE,
+        .id         = RPT_ID_FEATURE_KEY_STATS,
+        .size       = sizeof(KeyStatsReport),
+        .data       = &keyStatsRpt,
+        .set        = key_statsSetReport,
+    },
+#endif
+};
+
+/********************************************************************************
+ * Report ID to registry index, per report type
+ ********************************************************************************/
+static const uint8_t report_idx[WICED_HID_REPORT_TYPE_FEATURE][256] =
+{
+    [WICED_HID_REPORT_TYPE_INPUT-1] =
+    {
+        [RPT_ID_IN_STD_KEY]         = RPT_IDX_STD_KEY,
+        [RPT_ID_IN_BATTERY]         = RPT_IDX_BATTERY,
+        [RPT_ID_IN_BIT_MAPPED]      = RPT_IDX_BIT_MAPPED,
+        [RPT_ID_IN_SLEEP]           = RPT_IDX_SLEEP,
+        [RPT_ID_IN_FUNC_LOCK]       = RPT_IDX_FUNC_LOCK,
+        [RPT_ID_IN_SCROLL]          = RPT_IDX_SCROLL,
+        [RPT_ID_IN_CONSUMER]        = RPT_IDX_CONSUMER,
+#ifdef SUPPORT_CODE_ENTRY
+        [RPT_ID_IN_PIN]             = RPT_IDX_PIN,
+#endif
+    },
+
+    [WICED_HID_REPORT_TYPE_OUTPUT-1] =
+    {
+        [RPT_ID_OUT_KB_LED]         = RPT_IDX_KB_LED,
+    },
+
+    [WICED_HID_REPORT_TYPE_FEATURE-1] =
+    {
+        [RPT_ID_FEATURE_CNT_CTL]    = RPT_IDX_CNT_CTL,
+#ifdef SUPPORT_KEY_STATS
+        [RPT_ID_FEATURE_KEY_STATS]  = RPT_IDX_KEY_STATS,
+#endif
+    },
+};
+
+/********************************************************************************
+ * Function Name: report_index
+ ********************************************************************************
+ * Summary: Look up the registry index of a report
+ *
+ * Parameters:
+ *  type -- WICED_HID_REPORT_TYPE_INPUT, WICED_HID_REPORT_TYPE_OUTPUT or WICED_HID_REPORT_TYPE_FEATURE
+ *  id -- report ID
+ *
+ * Return:
+ *  registry index, RPT_IDX_NONE if the report is not defined
+ *
+ *******************************************************************************/
+uint8_t report_index(uint8_t type, uint8_t id)
+{
+    if ((type < WICED_HID_REPORT_TYPE_INPUT) || (type > WICED_HID_REPORT_TYPE_FEATURE))
+    {
+        return RPT_IDX_NONE;
+    }
+    return report_idx[type-1][id];
+}
+
+/********************************************************************************
+ * Function Name: report_find
+ ********************************************************************************
+ * Summary: Look up a report in the registry
+ *
+ * Parameters:
+ *  type -- WICED_HID_REPORT_TYPE_INPUT, WICED_HID_REPORT_TYPE_OUTPUT or WICED_HID_REPORT_TYPE_FEATURE
+ *  id -- report ID
+ *
+ * Return:
+ *  registry entry, NULL if the report is not defined
+ *
+ *******************************************************************************/
+const report_entry_t * report_find(uint8_t type, uint8_t id)
+{
+    uint8_t idx = report_index(type, id);
+
+    return idx == RPT_IDX_NONE ? NULL : &report_table[idx];
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Report registry
+ *
+ * One table describes every HID report of the application: type, report ID,
+ * size, storage and SET_REPORT handler. BR/EDR GET_REPORT/SET_REPORT and the
+ * LE report map are both served from it.
+ *
+ */
+
+#ifndef __APP_REPORT_H__
+#define __APP_REPORT_H__
+
+#include "wiced.h"
+#include "wiced_hidd_lib.h"
+
+/// registry index, one per report
+typedef enum {
+    RPT_IDX_NONE,           // no such report
+    RPT_IDX_STD_KEY,
+    RPT_IDX_KB_LED,
+    RPT_IDX_BATTERY,
+    RPT_IDX_BIT_MAPPED,
+    RPT_IDX_SLEEP,
+    RPT_IDX_FUNC_LOCK,
+    RPT_IDX_SCROLL,
+    RPT_IDX_CONSUMER,
+#ifdef SUPPORT_CODE_ENTRY
+    RPT_IDX_PIN,
+#endif
+    RPT_IDX_CNT_CTL,
+#ifdef SUPPORT_KEY_STATS
+    RPT_IDX_KEY_STATS,
+#endif
+    RPT_IDX_MAX
+} report_idx_e;
+
+/// SET_REPORT handler, same signature as the LE report map write callback
+typedef void (report_set_t)(wiced_hidd_report_type_t reportType,
+                            uint8_t reportId,
+                            void *payload,
+                            uint16_t payloadSize);
+
+typedef struct {
+    uint8_t         type;           // wiced_hidd_report_type_t
+    uint8_t         id;             // report ID
+    uint8_t         size;           // report size, report ID included
+    uint8_t         cccdBitmap;     // LE client config notification flag, APP_CLIENT_CONFIG_NOTIF_NONE if none
+    void          * data;           // report storage starting with the report ID, NULL if GET_REPORT is not supported
+    report_set_t  * set;            // SET_REPORT handler, NULL if the report is not writable
+} report_entry_t;
+
+extern const report_entry_t report_table[RPT_IDX_MAX];
+
+/// any input report, sizes the copies kept of the last report sent
+typedef union {
+    KeyboardStandardReport  stdRpt;
+    KeyboardBitMappedReport bitMappedReport;
+    KeyboardSleepReport     sleepReport;
+    KeyboardFuncLockReport  funcLockReport;
+    KeyboardMotionReport    scrollReport;
+    KeyboardConsumerReport  consumerReport;
+#ifdef SUPPORT_CODE_ENTRY
+    KeyboardPinEntryReport  pinReport;
+#endif
+#ifdef BATTERY_REPORT_SUPPORT
+    BatteryReport           batRpt;
+#endif
+} report_input_u;
+
+#define RPT_INPUT_MAX_SIZE  sizeof(report_input_u)    // largest input report
+
+/********************************************************************************
+ * Function Name: report_index
+ ********************************************************************************
+ * Summary: Look up the registry index of a report
+ *
+ * Parameters:
+ *  type -- WICED_HID_REPORT_TYPE_INPUT, WICED_HID_REPORT_TYPE_OUTPUT or WICED_HID_REPORT_TYPE_FEATURE
+ *  id -- report ID
+ *
+ * Return:
+ *  registry index, RPT_IDX_NONE if the report is not defined
+ *
+ *******************************************************************************/
+uint8_t report_index(uint8_t type, uint8_t id);
+
+/********************************************************************************
+ * Function Name: report_find
+ ********************************************************************************
+ * Summary: Look up a report in the registry
+ *
+ * Parameters:
+ *  type -- WICED_HID_REPORT_TYPE_INPUT, WICED_HID_REPORT_TYPE_OUTPUT or WICED_HID_REPORT_TYPE_FEATURE
+ *  id -- report ID
+ *
+ * Return:
+ *  registry entry, NULL if the report is not defined
+ *
+ *******************************************************************************/
+const report_entry_t * report_find(uint8_t type, uint8_t id);
+
+#endif // __APP_REPORT_H__
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Sleep deadline registry
+ *
+ */
+#include "app.h"
+
+
+typedef struct {
+    uint32_t startBtClk;                                      // BT clock when the deadline was posted
+    uint32_t timeout_ms;                                      // deadline from start, or period when periodic
+    uint8_t  pending:1;
+    uint8_t  periodic:1;
+} sleep_deadline_t;
+
+static sleep_deadline_t deadline[SLEEP_DEADLINE_MAX] = {};
+
+/********************************************************************************
+ * Function Name: SLEEP_post
+ ********************************************************************************
+ * Summary: Record a deadline in the slot
+ *
+ * Parameters:
+ *  id -- deadline slot
+ *  timeout_ms -- timeout or period in ms
+ *  periodic -- TRUE if the deadline repeats
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+STATIC void SLEEP_post(uint8_t id, uint32_t timeout_ms, wiced_bool_t periodic)
+{
+    if (id < SLEEP_DEADLINE_MAX)
+    {
+        deadline[id].startBtClk = wiced_hidd_get_current_native_bt_clocks();
+        deadline[id].timeout_ms = timeout_ms;
+        deadline[id].periodic = periodic && timeout_ms;
+        deadline[id].pending = TRUE;
+    }
+}
+
+/********************************************************************************
+ * Function Name: void sleep_post_deadline(uint8_t id, uint32_t timeout_ms)
+ ********************************************************************************
+ * Summary: Post a one shot deadline. Replaces the previous deadline of the slot.
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *  timeout_ms -- time from now in ms
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_post_deadline(uint8_t id, uint32_t timeout_ms)
+{
+    SLEEP_post(id, timeout_ms, FALSE);
+}
+
+/********************************************************************************
+ * Function Name: void sleep_post_periodic_deadline(uint8_t id, uint32_t period_ms)
+ ********************************************************************************
+ * Summary: Post a periodic deadline. The deadline repeats every period until
+ *          it is cleared.
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *  period_ms -- period in ms
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_post_periodic_deadline(uint8_t id, uint32_t period_ms)
+{
+    SLEEP_post(id, period_ms, TRUE);
+}
+
+/********************************************************************************
+ * Function Name: void sleep_clear_deadline(uint8_t id)
+ ********************************************************************************
+ * Summary: Remove the deadline of the slot
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_clear_deadline(uint8_t id)
+{
+    if (id < SLEEP_DEADLINE_MAX)
+    {
+        deadline[id].pending = FALSE;
+    }
+}
+
+/********************************************************************************
+ * Function Name: uint32_t sleep_time_to_deadline(uint8_t id)
+ ********************************************************************************
+ * Summary: Get the time left to the deadline of the slot
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *
+ * Return:
+ *  time left in ms, 0 if expired, SLEEP_NO_DEADLINE if no deadline is posted
+ *
+ *******************************************************************************/
+uint32_t sleep_time_to_deadline(uint8_t id)
+{
+    uint32_t elapsed_ms;
+
+    if ((id >= SLEEP_DEADLINE_MAX) || !deadline[id].pending)
+    {
+        return SLEEP_NO_DEADLINE;
+    }
+
+    elapsed_ms = BT_CLOCKS_TO_MS(wiced_hidd_get_bt_clocks_since(deadline[id].startBtClk));
+
+    if (deadline[id].periodic)
+    {
+        // time left to the next period boundary
+        return deadline[id].timeout_ms - (elapsed_ms % deadline[id].timeout_ms);
+    }
+
+    return (elapsed_ms < deadline[id].timeout_ms) ? deadline[id].timeout_ms - elapsed_ms : 0;
+}
+
+/********************************************************************************
+ * Function Name: uint32_t sleep_time_to_next_deadline(void)
+ ********************************************************************************
+ * Summary: Get the time left to the earliest pending deadline. Expired one
+ *          shot deadlines are removed.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  time left in ms, SLEEP_NO_DEADLINE if no deadline is pending
+ *
+ *******************************************************************************/
+uint32_t sleep_time_to_next_deadline(void)
+{
+    uint32_t next = SLEEP_NO_DEADLINE;
+    uint32_t left;
+    uint8_t id;
+
+    for (id = 0; id < SLEEP_DEADLINE_MAX; id++)
+    {
+        left = sleep_time_to_deadline(id);
+        if (left == 0)
+        {
+            // the owner has been woken up by its own timer, nothing to wait for anymore
+            sleep_clear_deadline(id);
+        }
+        else if (left < next)
+        {
+            next = left;
+        }
+    }
+    return next;
+}
+
+/********************************************************************************
+ * Function Name: void sleep_deep_sleep_not_allowed(uint32_t timeout_ms)
+ ********************************************************************************
+ * Summary: Block deep sleep for the given time and record the window end as
+ *          a deadline, so the sleep handler knows when shutdown sleep becomes
+ *          possible again.
+ *
+ * Parameters:
+ *  timeout_ms -- window length in ms
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_deep_sleep_not_allowed(uint32_t timeout_ms)
+{
+    hidd_deep_sleep_not_allowed(timeout_ms);
+    sleep_post_deadline(SLEEP_DEADLINE_NO_SHUTDOWN, timeout_ms);
+}
+
+/********************************************************************************
+ * Function Name: wiced_bool_t sleep_shutdown_allowed(void)
+ ********************************************************************************
+ * Summary: Check if the expected idle time is long enough for shutdown sleep
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if no deep sleep not allowed window is active and the earliest
+ *  deadline is at least SLEEP_SHUTDOWN_MIN_IDLE_MS away
+ *
+ *******************************************************************************/
+wiced_bool_t sleep_shutdown_allowed(void)
+{
+    uint32_t idle_ms = sleep_time_to_next_deadline();
+
+    if (deadline[SLEEP_DEADLINE_NO_SHUTDOWN].pending)
+    {
+        return FALSE;
+    }
+
+    return idle_ms >= SLEEP_SHUTDOWN_MIN_IDLE_MS;
+}
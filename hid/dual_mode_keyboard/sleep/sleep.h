@@ -0,0 +1,172 @@
+/*
+ * Copyright 2016-2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * Sleep deadline registry
+ *
+ * Each module that needs the CPU awake at a known time (timers, periodic
+ * measurements, LED blinking, no deep sleep windows) posts its next deadline
+ * here. The sleep permit handler uses the earliest deadline to tell the
+ * firmware exactly how long it can sleep and whether shutdown sleep (SDS/HIDOFF)
+ * is worth entering.
+ *
+ */
+#ifndef __APP_SLEEP_H__
+#define __APP_SLEEP_H__
+
+#include "wiced.h"
+
+/// deadline slots, one for each module that posts a wake time
+typedef enum {
+    SLEEP_DEADLINE_CONN_PARAM,      // LE connection parameter update timer
+    SLEEP_DEADLINE_BATTERY,         // next battery measurement
+    SLEEP_DEADLINE_LED_LE,          // LE link LED blink
+    SLEEP_DEADLINE_LED_BREDR,       // BR/EDR link LED blink
+    SLEEP_DEADLINE_NO_SHUTDOWN,     // end of deep sleep not allowed window
+    SLEEP_DEADLINE_MAX
+} sleep_deadline_e;
+
+/// returned when no deadline is pending
+#define SLEEP_NO_DEADLINE               0xffffffff
+
+/// Expected idle time below this does not pay back the SDS/HIDOFF entry and
+/// wake up cost, plain sleep is used instead.
+#define SLEEP_SHUTDOWN_MIN_IDLE_MS      100
+
+/********************************************************************************
+ * Function Name: void sleep_post_deadline(uint8_t id, uint32_t timeout_ms)
+ ********************************************************************************
+ * Summary: Post a one shot deadline. Replaces the previous deadline of the slot.
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *  timeout_ms -- time from now in ms
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_post_deadline(uint8_t id, uint32_t timeout_ms);
+
+/********************************************************************************
+ * Function Name: void sleep_post_periodic_deadline(uint8_t id, uint32_t period_ms)
+ ********************************************************************************
+ * Summary: Post a periodic deadline. The deadline repeats every period until
+ *          it is cleared.
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *  period_ms -- period in ms
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_post_periodic_deadline(uint8_t id, uint32_t period_ms);
+
+/********************************************************************************
+ * Function Name: void sleep_clear_deadline(uint8_t id)
+ ********************************************************************************
+ * Summary: Remove the deadline of the slot
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_clear_deadline(uint8_t id);
+
+/********************************************************************************
+ * Function Name: uint32_t sleep_time_to_deadline(uint8_t id)
+ ********************************************************************************
+ * Summary: Get the time left to the deadline of the slot
+ *
+ * Parameters:
+ *  id -- deadline slot, sleep_deadline_e
+ *
+ * Return:
+ *  time left in ms, 0 if expired, SLEEP_NO_DEADLINE if no deadline is posted
+ *
+ *******************************************************************************/
+uint32_t sleep_time_to_deadline(uint8_t id);
+
+/********************************************************************************
+ * Function Name: uint32_t sleep_time_to_next_deadline(void)
+ ********************************************************************************
+ * Summary: Get the time left to the earliest pending deadline. Expired one
+ *          shot deadlines are removed.
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  time left in ms, SLEEP_NO_DEADLINE if no deadline is pending
+ *
+ *******************************************************************************/
+uint32_t sleep_time_to_next_deadline(void);
+
+/********************************************************************************
+ * Function Name: void sleep_deep_sleep_not_allowed(uint32_t timeout_ms)
+ ********************************************************************************
+ * Summary: Block deep sleep for the given time and record the window end as
+ *          a deadline, so the sleep handler knows when shutdown sleep becomes
+ *          possible again.
+ *
+ * Parameters:
+ *  timeout_ms -- window length in ms
+ *
+ * Return:
+ *  none
+ *
+ *******************************************************************************/
+void sleep_deep_sleep_not_allowed(uint32_t timeout_ms);
+
+/********************************************************************************
+ * Function Name: wiced_bool_t sleep_shutdown_allowed(void)
+ ********************************************************************************
+ * Summary: Check if the expected idle time is long enough for shutdown sleep
+ *
+ * Parameters:
+ *  none
+ *
+ * Return:
+ *  TRUE if no deep sleep not allowed window is active and the earliest
+ *  deadline is at least SLEEP_SHUTDOWN_MIN_IDLE_MS away
+ *
+ *******************************************************************************/
+wiced_bool_t sleep_shutdown_allowed(void);
+
+#endif // __APP_SLEEP_H__